@@ -1,196 +1,88 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdint.h>
 
-#define MEM_SIZE 256
-#define HEADER_SIZE 4
-#define FILE_HEADER {0x03, 0x4E, 0x44, 0x52}
+#include "neander.h"
 
-uint8_t memory[MEM_SIZE * 2] = {0}; // Memória com dobro de tamanho, pois o binario do neander possui separadores 0x00 apos cada byte
-int code_size = 0;                  // Tamanho do .CODE para saber em qual endereço começar a salvar as variaveis
+// O montador fica em neander_assembler.c (libneander); aqui só são lidos e escritos os arquivos
 
-// Estrutura para armazenar variáveis
-typedef struct {
-    char name[10];
-    int address;
-    int value;
-    int initialized;
-} Variable;
-
-Variable variables[MEM_SIZE];
-int variable_count = 0;
-
-// Função para fornecer o opcode do mnemonico
-uint8_t get_opcode(char *mnemonic, int *has_operand) {
-    struct Mnemonic {
-        char *mnemonic;
-        uint8_t opcode;
-        int has_operand;    // Verificar se o mnemonico ocupa 2 endereços ou não, como no caso do NOP, NOT e HLT
-    };
-
-    struct Mnemonic mnemonics[] = {
-        {"NOP", 0x00, 0}, {"STA", 0x10, 1}, {"LDA", 0x20, 1}, {"ADD", 0x30, 1},
-        {"OR", 0x40, 1}, {"AND", 0x50, 1}, {"NOT", 0x60, 0}, {"JMP", 0x80, 1},
-        {"JN", 0x90, 1}, {"JZ", 0xA0, 1}, {"HLT", 0xF0, 0}, {NULL, 0, 0}
-    };
+int main(int argc, char *argv[]) {
+    ImageFormat format = FORMAT_PADDED;
+    int extended = 0;
+    const char *files[2];
+    int file_count = 0;
+    NeanderCache cache = {getenv("NEANDER_CACHE"), CACHE_DEFAULT_SIZE};
+    int show_stats = 0;
 
-    for (int i = 0; mnemonics[i].mnemonic != NULL; i++) {
-        if (strcmp(mnemonic, mnemonics[i].mnemonic) == 0) {
-            *has_operand = mnemonics[i].has_operand;
-            return mnemonics[i].opcode;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compact") == 0) {
+            format = FORMAT_COMPACT;
+        } else if (strcmp(argv[i], "--sparse") == 0) {
+            format = FORMAT_SPARSE;
+        } else if (strcmp(argv[i], "--ext") == 0) {
+            extended = 1;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache.dir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+            cache.max_bytes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            show_stats = 1;
+        } else if (file_count < 2) {
+            files[file_count++] = argv[i];
         }
     }
-    return 0xFF;
-}
 
-// Função para fornecer o endereço da variavel
-int get_variable_address(char *name) {
-    for (int i = 0; i < variable_count; i++) {
-        if (strcmp(variables[i].name, name) == 0) {
-            return variables[i].address;
-        }
+    if (show_stats) {
+        return neander_cache_print_stats(&cache) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
     }
-    return -1;
-}
 
-// Função para adicionar a variavel na lista de variaveis
-void add_variable(char *name, int value, int initialized) {
-    strcpy(variables[variable_count].name, name);
-    variables[variable_count].address = code_size + variable_count;
-    variables[variable_count].value = value;
-    variables[variable_count].initialized = initialized;
-    variable_count++;
-}
+    if (file_count < 2) {
+        printf("Uso: %s [--compact|--sparse] [--ext] [--cache <diretorio>] [--cache-size <bytes>] <arquivo.txt|-> <saida.mem>\n"
+               "     %s --cache-stats [--cache <diretorio>]\n", argv[0], argv[0]);
+        return 1;
+    }
 
-// Função para processar o arquivo
-void parse_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+    NeanderBuffer source = {0};
+    if (neander_read_file(files[0], &source) != 0) {
         perror("Erro ao abrir arquivo");
         exit(EXIT_FAILURE);
     }
-    
-    char line[256];
-    int parsing_code = 0;   // Verificar se esta na seção .DATA ou .CODE
-    int addr = 0;
-    
-    // Primeira passagem: calcular tamanho da seção .CODE
-    // para saber em qual endereço o valor das variaveis devem começar a ser salvos
-    while (fgets(line, sizeof(line), file)) {
-        if (line[0] == ';' || line[0] == '\n') continue;    // Se a linha for comentario, entao ignora
-        
-        if (strstr(line, ".DATA")) {
-            parsing_code = 0;   // Se estiver na seção .DATA, então valor é 0
-            continue;
-        }
-        if (strstr(line, ".CODE")) {
-            parsing_code = 1;   // // Se estiver na seção .CODE, então valor é 1
-            continue;
-        }
-        
-        // Contar quantidade de endereços usados pela seção .CODE
-        if (parsing_code) { 
-            char mnemonic[10], operand_str[10];
-            int has_operand;
-            if (sscanf(line, "%s %s", mnemonic, operand_str) == 2 || sscanf(line, "%s", mnemonic) == 1) {
-                uint8_t opcode = get_opcode(mnemonic, &has_operand);
-                if (opcode != 0xFF) {
-                    addr += 2;  // Soma 2, pois cada byte é seguido por um separador 00 no arquivo do neander
-                    if (has_operand) addr += 2;
-                }
-            }
-        }
+
+    // Chave do cache: versão do montador, opções e assembly
+    NeanderBuffer image = {0};
+    NeanderBuffer key = {0};
+    int cached = 0;
+    if (cache.dir) {
+        char config[64];
+        snprintf(config, sizeof(config), "assembler %d %d", (int)format, extended);
+        neander_cache_key_version(&key, argv[0]);
+        neander_cache_key_add(&key, config, strlen(config));
+        neander_cache_key_add(&key, source.data, source.len);
+        cached = neander_cache_get(&cache, &key, "mem", &image) == 0;
     }
-    
-    code_size = addr / 2;   // Divide o endereço por 2, pois cada byte é seguido por um separador 00 no arquivo binario
-    rewind(file);
-    parsing_code = 0;
-    addr = 0;
-    
-    // Segunda passagem: armazenar código e variáveis corretamente
-    while (fgets(line, sizeof(line), file)) {
-        if (line[0] == ';' || line[0] == '\n') continue;
-        
-        if (strstr(line, ".DATA")) {
-            parsing_code = 0;
-            continue;
-        }
-        if (strstr(line, ".CODE")) {
-            parsing_code = 1;
-            continue;
+
+    if (!cached) {
+        char error[256];
+        if (neander_assemble(source.data, source.len, format, extended, &image, error, sizeof(error)) != 0) {
+            fprintf(stderr, "Erro: %s\n", error);
+            exit(EXIT_FAILURE);
         }
-        
-        if (!parsing_code) { // .DATA
-            char var_name[10], value_str[10];
-            int value, initialized = 1;
-            if (sscanf(line, "%s DB %s", var_name, value_str) == 2) {   // Verifica se a linha esta no formato: Nome DB Valor
-                if (strcmp(value_str, "?") == 0) {  // Verifica se a variavel tem um valor ou não
-                    value = 0;
-                    initialized = 0;
-                } else {
-                    value = atoi(value_str);
-                }
-                add_variable(var_name, value, initialized);
-            }
-        } else { // .CODE
-            char mnemonic[10], operand_str[10];
-            int operand;
-            int has_operand;
-            
-            if (sscanf(line, "%s %s", mnemonic, operand_str) == 2) {    // Verifica se a linha esta no formato: Mnemonico Operando
-                uint8_t opcode = get_opcode(mnemonic, &has_operand);    // Converte o mnemonico em opcode
-                if (opcode != 0xFF) {
-                    memory[addr++] = opcode;    // Adiciona o opcode na memoria
-                    memory[addr++] = 0x00;      // Adiciona o separador 00 que o arquivo do neander possui após cada byte
-                    
-                    if (has_operand) {
-                        operand = get_variable_address(operand_str);
-                        if (operand == -1) operand = atoi(operand_str);
-                        memory[addr++] = (uint8_t)operand;  // Adiciona o operando na memoria
-                        memory[addr++] = 0x00;              // Adiciona o separador 00 que o arquivo do neander possui após cada byte
-                    }
-                }
-            } else if (sscanf(line, "%s", mnemonic) == 1) {
-                uint8_t opcode = get_opcode(mnemonic, &has_operand);
-                if (opcode != 0xFF) {
-                    memory[addr++] = opcode;
-                    memory[addr++] = 0x00;
-                }
-            }
+        if (cache.dir && neander_cache_put(&cache, &key, "mem", &image) != 0) {
+            fprintf(stderr, "Aviso: nao foi possivel gravar no cache %s\n", cache.dir);
         }
     }
-    fclose(file);
-    
-    // Armazenar valores das variáveis na memória nos endereços corretos
-    for (int i = 0; i < variable_count; i++) {
-        memory[variables[i].address * 2] = variables[i].value;  // Endereço é multiplicado por 2, pois cada byte é seguido por um separador 00
-    }
-}
 
-// Funçao para escrever o arquivo binario
-void write_binary(const char *filename) {
-    FILE *file = fopen(filename, "wb");
+    FILE *file = fopen(files[1], "wb");
     if (!file) {
         perror("Erro ao criar binário");
         exit(EXIT_FAILURE);
     }
-    
-    uint8_t header[] = FILE_HEADER;
-    fwrite(header, 1, HEADER_SIZE, file);
-    fwrite(memory, 1, MEM_SIZE * 2, file);
+    fwrite(image.data, 1, image.len, file);
     fclose(file);
-}
 
-int main(int argc, char *argv[]) {
-    if (argc < 3) {
-        printf("Uso: %s <arquivo.txt> <saida.mem>\n", argv[0]);
-        return 1;
-    }
-
-    parse_file(argv[1]);
-    write_binary(argv[2]);
-
-    printf("Arquivo %s gerado com sucesso!\n", argv[2]);
+    neander_buffer_free(&source);
+    neander_buffer_free(&image);
+    neander_buffer_free(&key);
+    printf("Arquivo %s gerado com sucesso!\n", files[1]);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,13 @@
+.DATA
+A DB 100
+B DB 24
+C DB 0
+D DB 191
+E DB 131
+X DB ?
+
+.CODE
+.ORG 0
+LDA D
+STA X
+HLT
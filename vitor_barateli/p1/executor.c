@@ -2,148 +2,989 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stddef.h>
 
-#define MEM_SIZE 256    // Define o tamanho da memória da máquina Neander (256 bytes)
-#define MAGIC_HEADER {0x03, 0x4E, 0x44, 0x52}   // // Define o cabeçalho mágico esperado nos arquivos .mem
+#include "neander.h"
 
-// Retorna o mnemônico correspondente ao opcode
-const char* get_mnemonic(uint8_t opcode) {
-    switch (opcode & 0xF0) {
-        case 0x00: return "NOP";
-        case 0x10: return "STA";
-        case 0x20: return "LDA";
-        case 0x30: return "ADD";
-        case 0x40: return "OR";
-        case 0x50: return "AND";
-        case 0x60: return "NOT";
-        case 0x80: return "JMP";
-        case 0x90: return "JN";
-        case 0xA0: return "JZ";
-        case 0xF0: return "HLT";
-        default: return "";
+// Carrega o conteúdo do arquivo .mem na memória simulada, encerrando o programa em caso de erro
+// Retorna LOAD_ERR_EXTENDED para imagens do modo estendido, que o chamador carrega à parte
+int load_memory(const char *filename, uint8_t *memory) {
+    int status = neander_load_image(filename, memory);
+
+    if (status == LOAD_ERR_OPEN) {
+        perror("Erro ao abrir o arquivo");
+        exit(EXIT_FAILURE);
+    }
+    if (status == LOAD_ERR_FORMAT) {
+        fprintf(stderr, "Erro: O arquivo fornecido nao e um arquivo .mem valido.\n");
+        exit(EXIT_FAILURE);
     }
+    return status;
 }
 
-// Verifica se a próxima instrução ocupa 2 bytes (opcode + operando)
-int should_skip_next(const char* mnemonic) {
-    // Somente NOT, NOP e HLT são de 1 byte
-    return (mnemonic[0] != '\0' && strcmp(mnemonic, "NOP") != 0 && strcmp(mnemonic, "HLT") != 0 && strcmp(mnemonic, "NOT") != 0);
+// Linha de um relatório ordenado do perfil
+typedef struct {
+    int addr;
+    uint64_t count;
+} ProfileRow;
+
+// Laço encontrado por uma aresta de retorno (desvio tomado para um endereço anterior)
+typedef struct {
+    int header;         // Destino da aresta de retorno (início do laço)
+    int latch;          // Desvio que volta para o início
+    uint64_t backedges; // Vezes que a aresta de retorno foi tomada
+    uint64_t entries;   // Vezes que o laço foi iniciado por fora da aresta de retorno
+    uint64_t work;      // Instruções executadas entre header e latch
+} ProfileLoop;
+
+int compare_rows(const void *a, const void *b) {
+    const ProfileRow *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return x->addr - y->addr;
 }
 
-// Carrega o conteúdo do arquivo .mem na memória simulada
-void load_memory(const char *filename, uint8_t *memory) {
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        perror("Erro ao abrir o arquivo");
-        exit(EXIT_FAILURE);
+int compare_loops(const void *a, const void *b) {
+    const ProfileLoop *x = a, *y = b;
+    if (x->work != y->work) return x->work < y->work ? 1 : -1;
+    return x->header - y->header;
+}
+
+// Escreve a instrução do endereço pc no formato "MNEMONICO OPERANDO"
+void format_insn(const uint8_t *memory, int pc, char *buf, size_t size) {
+    const char *mnemonic = neander_get_mnemonic(memory[pc]);
+    if (mnemonic[0] == '\0') {
+        snprintf(buf, size, "DB %02X", memory[pc]);
+    } else if (neander_should_skip_next(mnemonic) && pc + 1 < MEM_SIZE) {
+        snprintf(buf, size, "%s %02X", mnemonic, memory[pc + 1]);
+    } else {
+        snprintf(buf, size, "%s", mnemonic);
     }
+}
 
-    // Lê e valida o cabeçalho do arquivo
-    uint8_t header[4];
-    fread(header, 1, 4, file);
-    uint8_t expected_header[] = MAGIC_HEADER;
-    
-    if (memcmp(header, expected_header, 4) != 0) {
-        fprintf(stderr, "Erro: O arquivo fornecido nao e um arquivo .mem valido.\n");
-        fclose(file);
+// Monta a lista de linhas com contagem diferente de zero, em ordem decrescente
+int profile_rows(const uint64_t *a, const uint64_t *b, ProfileRow *rows) {
+    int count = 0;
+    for (int i = 0; i < MEM_SIZE; i++) {
+        uint64_t value = a[i] + (b ? b[i] : 0);
+        if (value) {
+            rows[count].addr = i;
+            rows[count].count = value;
+            count++;
+        }
+    }
+    qsort(rows, count, sizeof(ProfileRow), compare_rows);
+    return count;
+}
+
+// Encontra os laços pelas arestas de retorno e calcula entradas e iterações médias
+int profile_loops(const Profile *p, ProfileLoop *loops) {
+    uint64_t back_to[MEM_SIZE] = {0};
+    int count = 0;
+
+    for (int pc = 0; pc < MEM_SIZE; pc++) {
+        if (p->taken[pc] && p->target[pc] <= pc) back_to[p->target[pc]] += p->taken[pc];
+    }
+    for (int pc = 0; pc < MEM_SIZE; pc++) {
+        if (!p->taken[pc] || p->target[pc] > pc) continue;
+        ProfileLoop *l = &loops[count++];
+        l->header = p->target[pc];
+        l->latch = pc;
+        l->backedges = p->taken[pc];
+        l->entries = p->exec[l->header] - back_to[l->header];
+        l->work = 0;
+        for (int i = l->header; i <= pc; i++) l->work += p->exec[i];
+    }
+    qsort(loops, count, sizeof(ProfileLoop), compare_loops);
+    return count;
+}
+
+// Imprime o relatório de perfil em texto, com cada seção ordenada da mais quente para a mais fria
+void print_profile(const Profile *p, const uint8_t *image) {
+    ProfileRow rows[MEM_SIZE];
+    ProfileLoop loops[MEM_SIZE];
+    char insn[16];
+    int count;
+
+    printf("\nPerfil: %llu instrucoes executadas\n", (unsigned long long)p->total);
+
+    printf("\nInstrucoes por PC:\nPC\tContagem\t%%\tInstrucao\n");
+    count = profile_rows(p->exec, NULL, rows);
+    for (int i = 0; i < count; i++) {
+        format_insn(image, rows[i].addr, insn, sizeof(insn));
+        printf("%02X\t%llu\t%6.2f%%\t%s\n", rows[i].addr, (unsigned long long)rows[i].count,
+               100.0 * rows[i].count / p->total, insn);
+    }
+
+    printf("\nDesvios condicionais:\nPC\tInstrucao\tTomados\tNao tomados\n");
+    count = profile_rows(p->taken, p->not_taken, rows);
+    for (int i = 0; i < count; i++) {
+        uint8_t op = image[rows[i].addr] & 0xF0;
+        if (op != 0x90 && op != 0xA0) continue;
+        format_insn(image, rows[i].addr, insn, sizeof(insn));
+        printf("%02X\t%s\t\t%llu\t%llu\n", rows[i].addr, insn, (unsigned long long)p->taken[rows[i].addr],
+               (unsigned long long)p->not_taken[rows[i].addr]);
+    }
+
+    printf("\nAcessos a memoria:\nEnd\tLeituras\tEscritas\n");
+    count = profile_rows(p->reads, p->writes, rows);
+    for (int i = 0; i < count; i++) {
+        printf("%02X\t%llu\t\t%llu\n", rows[i].addr, (unsigned long long)p->reads[rows[i].addr],
+               (unsigned long long)p->writes[rows[i].addr]);
+    }
+
+    printf("\nLacos (arestas de retorno):\nInicio\tRetorno\tEntradas\tIteracoes\tMedia\tInstrucoes\n");
+    count = profile_loops(p, loops);
+    for (int i = 0; i < count; i++) {
+        const ProfileLoop *l = &loops[i];
+        uint64_t iterations = l->entries + l->backedges;
+        printf("%02X\t%02X\t%llu\t\t%llu\t\t%.2f\t%llu\n", l->header, l->latch, (unsigned long long)l->entries,
+               (unsigned long long)iterations, l->entries ? (double)iterations / l->entries : 0.0,
+               (unsigned long long)l->work);
+    }
+}
+
+// Escreve o mesmo relatório de perfil em JSON, para comparar versões de um programa
+void write_profile_json(const Profile *p, const uint8_t *image, const char *filename) {
+    ProfileRow rows[MEM_SIZE];
+    ProfileLoop loops[MEM_SIZE];
+    char insn[16];
+    int count;
+    FILE *out = fopen(filename, "w");
+
+    if (!out) {
+        perror("Erro ao criar arquivo de perfil");
         exit(EXIT_FAILURE);
     }
 
-    // Lê os dados de memória (somente os bytes de instruções, pula os espaços extras)
-    int index = 0;
-    uint8_t byte;
-    while (fread(&byte, 1, 1, file) == 1) {
-        if (index % 2 == 0) {
-            memory[index / 2] = byte;
+    fprintf(out, "{\n  \"instrucoes_executadas\": %llu,\n", (unsigned long long)p->total);
+
+    fprintf(out, "  \"pcs\": [");
+    count = profile_rows(p->exec, NULL, rows);
+    for (int i = 0; i < count; i++) {
+        format_insn(image, rows[i].addr, insn, sizeof(insn));
+        fprintf(out, "%s\n    {\"pc\": %d, \"contagem\": %llu, \"instrucao\": \"%s\"}", i ? "," : "",
+                rows[i].addr, (unsigned long long)rows[i].count, insn);
+    }
+    fprintf(out, "\n  ],\n");
+
+    fprintf(out, "  \"desvios\": [");
+    count = profile_rows(p->taken, p->not_taken, rows);
+    int first = 1;
+    for (int i = 0; i < count; i++) {
+        uint8_t op = image[rows[i].addr] & 0xF0;
+        if (op != 0x90 && op != 0xA0) continue;
+        format_insn(image, rows[i].addr, insn, sizeof(insn));
+        fprintf(out, "%s\n    {\"pc\": %d, \"instrucao\": \"%s\", \"tomados\": %llu, \"nao_tomados\": %llu}",
+                first ? "" : ",", rows[i].addr, insn, (unsigned long long)p->taken[rows[i].addr],
+                (unsigned long long)p->not_taken[rows[i].addr]);
+        first = 0;
+    }
+    fprintf(out, "\n  ],\n");
+
+    fprintf(out, "  \"memoria\": [");
+    count = profile_rows(p->reads, p->writes, rows);
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s\n    {\"endereco\": %d, \"leituras\": %llu, \"escritas\": %llu}", i ? "," : "",
+                rows[i].addr, (unsigned long long)p->reads[rows[i].addr], (unsigned long long)p->writes[rows[i].addr]);
+    }
+    fprintf(out, "\n  ],\n");
+
+    fprintf(out, "  \"lacos\": [");
+    count = profile_loops(p, loops);
+    for (int i = 0; i < count; i++) {
+        const ProfileLoop *l = &loops[i];
+        uint64_t iterations = l->entries + l->backedges;
+        fprintf(out, "%s\n    {\"inicio\": %d, \"retorno\": %d, \"entradas\": %llu, \"iteracoes\": %llu, "
+                "\"media\": %.2f, \"instrucoes\": %llu}", i ? "," : "", l->header, l->latch,
+                (unsigned long long)l->entries, (unsigned long long)iterations,
+                l->entries ? (double)iterations / l->entries : 0.0, (unsigned long long)l->work);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+}
+
+// Retorna o tempo atual em segundos (relógio monotônico)
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Executa a imagem runs vezes com um motor e retorna o tempo total em segundos
+// Cada rodada parte de uma cópia da imagem original, pois o programa pode alterar a memória
+double bench_engine(const Neander *image, long runs, EngineKind engine, Neander *result) {
+    double t0 = now_seconds();
+    for (long i = 0; i < runs; i++) {
+        *result = *image;
+        neander_run_engine(result, engine);
+    }
+    return now_seconds() - t0;
+}
+
+// Mede instruções por segundo de cada motor de execução e confere se os resultados são iguais
+void benchmark(const Neander *image, long runs) {
+    static const struct { const char *name; EngineKind engine; int use_idioms; } engines[] = {
+        {"pre-decodif.", ENGINE_THREADED, 0}, {"idiomas", ENGINE_THREADED, 1}, {"jit", ENGINE_JIT, 0}
+    };
+    Neander ref, vm, copy = *image;
+    uint64_t steps;
+    double t_switch;
+
+    // A contagem de instruções vem do interpretador de referência, que executa passo a passo
+    ref = *image;
+    steps = neander_run_switch(&ref);
+    t_switch = bench_engine(image, runs, ENGINE_SWITCH, &ref);
+
+    double total = (double)steps * runs;
+    printf("Benchmark: %ld execucoes, %llu instrucoes por execucao\n", runs, (unsigned long long)steps);
+    printf("%-13s %8.3f s  %10.2f Minstr/s\n", "switch:", t_switch, total / t_switch / 1e6);
+
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        copy.use_idioms = engines[i].use_idioms;
+        double t = bench_engine(&copy, runs, engines[i].engine, &vm);
+        if (memcmp(vm.memory, ref.memory, MEM_SIZE) != 0 || vm.AC != ref.AC || vm.PC != ref.PC ||
+            vm.N != ref.N || vm.Z != ref.Z || vm.stop != ref.stop) {
+            fprintf(stderr, "Erro: o motor %s produziu resultado diferente do interpretador de referencia.\n", engines[i].name);
+            exit(EXIT_FAILURE);
         }
-        index++;
+        printf("%-12s: %8.3f s  %10.2f Minstr/s  (%.2fx)\n", engines[i].name, t, total / t / 1e6, t_switch / t);
     }
-    
-    fclose(file);
 }
 
-// Imprime o conteúdo da memória
-void print_memory(uint8_t *memory) {
-    printf("Reg\tValor\tMnemonico\n");
-    int show_mnemonic = 1;  // Flag para controlar exibição de mnemônicos
-    
+// Calcula o hash FNV-1a (64 bits) da memória final, usado para comparar execuções no modo em lote
+uint64_t memory_hash(const uint8_t *memory) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
     for (int i = 0; i < MEM_SIZE; i++) {
-        const char *mnemonic = show_mnemonic ? get_mnemonic(memory[i]) : "";
-        
-        if (should_skip_next(mnemonic) && i + 1 < MEM_SIZE) {
-            printf("%02X\t%02X\t%s %02X\n", i, memory[i], mnemonic, memory[i + 1]);
-            show_mnemonic = 0;
-        } else {
-            printf("%02X\t%02X\t%s\n", i, memory[i], mnemonic);
-            
-            // Controla se o próximo byte deve mostrar mnemônico ou não
-            if (strcmp(mnemonic, "NOP") == 0 || strcmp(mnemonic, "HLT") == 0 || strcmp(mnemonic, "NOT") == 0) {
-                show_mnemonic = 1;
-            } else {
-                show_mnemonic = (mnemonic[0] == '\0');
+        hash ^= memory[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Faixa [head, tail) de imagens ainda não executadas de uma thread.
+// A dona retira pela cabeça, as outras threads roubam metade pela cauda
+typedef struct {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+} WorkQueue;
+
+// Estado compartilhado do modo em lote
+typedef struct {
+    char **files;
+    int count;
+    char **results;         // Linha de saída de cada imagem, na ordem da entrada
+    WorkQueue *queues;
+    int workers;
+    EngineKind engine;
+    int with_hash;
+    uint64_t jump_limit;
+    int use_idioms;
+} Batch;
+
+// Argumento de cada thread do modo em lote
+typedef struct {
+    Batch *batch;
+    int id;
+} Worker;
+
+// Calcula o hash FNV-1a dos 64 KiB de memória de uma instância do modo estendido
+uint64_t ext_memory_hash(const NeanderExt *vm) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int p = 0; p < EXT_PAGES; p++) {
+        for (int i = 0; i < EXT_PAGE_SIZE; i++) {
+            hash ^= vm->pages[p][i];
+            hash *= 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+
+// Acrescenta em line a linha de resultado de uma imagem do lote
+void format_batch_line(NeanderBuffer *line, const char *name, StopReason stop, uint8_t AC, uint32_t PC,
+                       uint8_t N, uint8_t Z, int with_hash, uint64_t hash) {
+    static const char *stop_names[] = {"HLT", "FIM", "LIMITE"};
+
+    neander_buffer_printf(line, "%s\t%s\tAC=%02X\tPC=%02X\tN=%d\tZ=%d", name, stop_names[stop], AC, PC, N, Z);
+    if (with_hash) {
+        neander_buffer_printf(line, "\tHASH=%016llx", (unsigned long long)hash);
+    }
+    neander_buffer_printf(line, "\n");
+}
+
+// Executa uma imagem do lote com uma instância própria da máquina e formata o resultado
+// Imagens do modo estendido usam o interpretador do modo estendido, qualquer que seja o motor
+void batch_run_image(Batch *b, int index) {
+    Neander vm = {0};
+    NeanderBuffer line = {0};
+    int status, ext_failed = 0;
+
+    neander_set_jump_limit(&vm, b->jump_limit);
+    vm.use_idioms = b->use_idioms;
+    status = neander_load_image(b->files[index], vm.memory);
+
+    if (status == LOAD_ERR_EXTENDED) {
+        NeanderExt ext;
+        neander_ext_init(&ext);
+        status = neander_load_ext_image(b->files[index], &ext);
+        if (status == LOAD_OK) {
+            ext.jumps_left = vm.jumps_left;
+            neander_ext_interpret(&ext);
+            ext_failed = ext.failed;
+        }
+        if (status == LOAD_OK && !ext_failed) {
+            format_batch_line(&line, b->files[index], ext.stop, ext.AC, ext.PC, ext.N, ext.Z,
+                              b->with_hash, b->with_hash ? ext_memory_hash(&ext) : 0);
+        }
+        neander_ext_free(&ext);
+    } else if (status == LOAD_OK) {
+        neander_run_engine(&vm, b->engine);
+        format_batch_line(&line, b->files[index], vm.stop, vm.AC, vm.PC, vm.N, vm.Z,
+                          b->with_hash, b->with_hash ? memory_hash(vm.memory) : 0);
+    }
+
+    if (status == LOAD_ERR_OPEN) {
+        neander_buffer_printf(&line, "%s\tERRO\tarquivo nao pode ser aberto\n", b->files[index]);
+    } else if (status == LOAD_ERR_FORMAT) {
+        neander_buffer_printf(&line, "%s\tERRO\tarquivo .mem invalido\n", b->files[index]);
+    } else if (status == LOAD_ERR_MEMORY || ext_failed) {
+        neander_buffer_printf(&line, "%s\tERRO\tmemoria insuficiente\n", b->files[index]);
+    }
+    b->results[index] = line.data;      // A linha passa a ser do lote (liberada com free)
+}
+
+// Retira a próxima imagem da fila da própria thread (-1 se a fila está vazia)
+int queue_pop(WorkQueue *q) {
+    int index = -1;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) {
+        index = q->head++;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return index;
+}
+
+// Rouba metade das imagens restantes de outra thread para a fila de id
+// Retorna 1 se conseguiu trabalho, 0 se todas as filas estão vazias
+int queue_steal(Batch *b, int id) {
+    for (int k = 1; k < b->workers; k++) {
+        WorkQueue *victim = &b->queues[(id + k) % b->workers];
+        int head = 0, tail = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        int remaining = victim->tail - victim->head;
+        if (remaining > 0) {
+            tail = victim->tail;
+            head = tail - (remaining + 1) / 2;
+            victim->tail = head;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (tail > head) {
+            WorkQueue *own = &b->queues[id];
+            pthread_mutex_lock(&own->lock);
+            own->head = head;
+            own->tail = tail;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Laço de cada thread: executa a própria faixa e rouba das outras quando ela acaba
+void *batch_worker(void *arg) {
+    Worker *w = arg;
+    Batch *b = w->batch;
+
+    for (;;) {
+        int index = queue_pop(&b->queues[w->id]);
+        if (index < 0) {
+            if (!queue_steal(b, w->id)) break;
+            continue;
+        }
+        batch_run_image(b, index);
+    }
+    return NULL;
+}
+
+// Adiciona um caminho à lista de imagens do lote
+void add_file(char ***files, int *count, int *capacity, const char *path) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *files = realloc(*files, *capacity * sizeof(char *));
+        if (!*files) {
+            perror("Erro de memoria");
+            exit(EXIT_FAILURE);
+        }
+    }
+    (*files)[(*count)++] = strdup(path);
+}
+
+int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Monta a lista de imagens: todos os .mem de um diretório (em ordem alfabética)
+// ou os caminhos de um arquivo de lista, um por linha
+char **collect_files(const char *source, int *count) {
+    char **files = NULL;
+    int capacity = 0;
+    DIR *dir = opendir(source);
+    *count = 0;
+
+    if (dir) {
+        struct dirent *entry;
+        char path[4096];
+        while ((entry = readdir(dir)) != NULL) {
+            size_t len = strlen(entry->d_name);
+            if (len > 4 && strcmp(entry->d_name + len - 4, ".mem") == 0) {
+                snprintf(path, sizeof(path), "%s/%s", source, entry->d_name);
+                add_file(&files, count, &capacity, path);
+            }
+        }
+        closedir(dir);
+        qsort(files, *count, sizeof(char *), compare_names);
+        return files;
+    }
+
+    FILE *list = fopen(source, "r");
+    if (!list) {
+        perror("Erro ao abrir a lista de imagens");
+        exit(EXIT_FAILURE);
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), list)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == ';') continue;
+        add_file(&files, count, &capacity, line);
+    }
+    fclose(list);
+    return files;
+}
+
+// Executa todas as imagens do lote em um pool de threads com roubo de trabalho
+// e escreve os resultados em um único fluxo de saída, na ordem da entrada
+void run_batch(const char *source, const char *output, int workers, EngineKind engine, int with_hash, uint64_t jump_limit, int use_idioms) {
+    Batch b = {0};
+    double start = now_seconds();
+
+    b.files = collect_files(source, &b.count);
+    b.results = calloc(b.count ? b.count : 1, sizeof(char *));
+    b.engine = engine;
+    b.with_hash = with_hash;
+    b.jump_limit = jump_limit;
+    b.use_idioms = use_idioms;
+
+    if (workers <= 0) {
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (workers > b.count) workers = b.count;
+    if (workers < 1) workers = 1;
+    b.workers = workers;
+
+    // Cada thread começa com uma faixa contígua do mesmo tamanho
+    b.queues = calloc(workers, sizeof(WorkQueue));
+    pthread_t *threads = calloc(workers, sizeof(pthread_t));
+    Worker *args = calloc(workers, sizeof(Worker));
+    if (!b.results || !b.queues || !threads || !args) {
+        perror("Erro de memoria");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_init(&b.queues[i].lock, NULL);
+        b.queues[i].head = (int)((long)b.count * i / workers);
+        b.queues[i].tail = (int)((long)b.count * (i + 1) / workers);
+    }
+
+    for (int i = 0; i < workers; i++) {
+        args[i].batch = &b;
+        args[i].id = i;
+        if (pthread_create(&threads[i], NULL, batch_worker, &args[i]) != 0) {
+            perror("Erro ao criar thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        perror("Erro ao criar arquivo de saida");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < b.count; i++) {
+        if (b.results[i]) fputs(b.results[i], out);
+        else fprintf(out, "%s\tERRO\tmemoria insuficiente\n", b.files[i]);   // A própria linha não coube
+        free(b.results[i]);
+        free(b.files[i]);
+    }
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%d imagens executadas em %.3f s com %d threads\n", b.count, now_seconds() - start, workers);
+
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_destroy(&b.queues[i].lock);
+    }
+    free(b.files);
+    free(b.results);
+    free(b.queues);
+    free(threads);
+    free(args);
+}
+
+#define ENSEMBLE_LANES 32   // Instâncias executadas juntas no modo conjunto (um vetor de 256 bits por byte)
+
+// Lê o arquivo de entradas do modo conjunto: cada linha não vazia gera uma instância com a
+// imagem base e os bytes "EE=VV" (endereço e valor em hexadecimal) da linha. Linhas com # são ignoradas
+Neander *read_inputs(const char *filename, const Neander *image, int **lines, int *count) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        perror("Erro ao abrir o arquivo de entradas");
+        exit(EXIT_FAILURE);
+    }
+
+    Neander *vms = NULL;
+    int capacity = 0, line_no = 0;
+    char line[4096];
+
+    *count = 0;
+    *lines = NULL;
+    while (fgets(line, sizeof(line), file)) {
+        char *token = strtok(line, " \t\r\n");
+        line_no++;
+        if (!token || token[0] == '#') continue;
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            vms = realloc(vms, capacity * sizeof(Neander));
+            *lines = realloc(*lines, capacity * sizeof(int));
+            if (!vms || !*lines) {
+                perror("Erro de memoria");
+                exit(EXIT_FAILURE);
             }
         }
+        Neander *vm = &vms[*count];
+        *vm = *image;
+        (*lines)[(*count)++] = line_no;
+
+        for (; token; token = strtok(NULL, " \t\r\n")) {
+            unsigned int addr, value;
+            char extra;
+            if (sscanf(token, "%x=%x%c", &addr, &value, &extra) != 2 || addr >= MEM_SIZE || value > 0xFF) {
+                fprintf(stderr, "Erro: entrada invalida '%s' na linha %d de %s (use EE=VV em hexadecimal).\n",
+                        token, line_no, filename);
+                exit(EXIT_FAILURE);
+            }
+            vm->memory[addr] = value;
+        }
+    }
+    fclose(file);
+    return vms;
+}
+
+#if defined(__GNUC__)
+
+typedef uint8_t Lanes __attribute__((vector_size(ENSEMBLE_LANES)));
+typedef int8_t SignedLanes __attribute__((vector_size(ENSEMBLE_LANES)));
+typedef uint64_t LaneWords __attribute__((vector_size(ENSEMBLE_LANES)));
+
+// Máscaras de lanes valem 0xFF (instância incluída) ou 0x00
+#define LANES_ANY(v) ((((LaneWords)(v))[0] | ((LaneWords)(v))[1] | ((LaneWords)(v))[2] | ((LaneWords)(v))[3]) != 0)
+#define LANES_BLEND(mask, a, b) (((a) & (mask)) | ((b) & ~(mask)))
+
+// Até ENSEMBLE_LANES instâncias do mesmo programa, com a memória e o AC de cada uma em uma lane.
+// As instâncias com o mesmo PC executam juntas; as que seguem outro caminho esperam em waiting
+// até que o grupo atual chegue ao PC delas (o grupo com o menor PC executa primeiro)
+typedef struct {
+    Lanes memory[MEM_SIZE];         // memory[endereço][lane]
+    Lanes waiting[MEM_SIZE];        // Instâncias paradas em cada PC
+    Lanes AC;
+    Lanes ran;                      // Instâncias que já executaram algo além de HLT (N e Z valem f(AC))
+    uint8_t parked[MEM_SIZE];       // 1 se waiting[pc] não está vazio
+    uint8_t uniform[MEM_SIZE + 1];  // 1 se o byte é igual em todas as lanes (a busca não precisa conferir)
+    int min_wait;                   // Menor PC com instâncias esperando (MEM_SIZE se nenhuma)
+    int limited;                    // Alguma instância tem limite de desvios
+    Neander *vms;
+    int count;
+} Ensemble;
+
+// Grava AC, PC e flags das instâncias da máscara, que terminaram a execução
+void ensemble_finish(Ensemble *en, const Lanes *mask, int pc, StopReason stop) {
+    for (int i = 0; i < en->count; i++) {
+        if (!(*mask)[i]) continue;
+        Neander *vm = &en->vms[i];
+        vm->AC = en->AC[i];
+        vm->PC = pc;
+        vm->N = en->ran[i] && (vm->AC & 0x80);
+        vm->Z = en->ran[i] && vm->AC == 0;
+        vm->stop = stop;
+    }
+}
+
+// Coloca as instâncias da máscara para esperar em pc (ou as encerra, se pc passou do fim da memória)
+void ensemble_park(Ensemble *en, const Lanes *mask, int pc) {
+    if (!LANES_ANY(*mask)) return;
+    if (pc >= MEM_SIZE) {
+        ensemble_finish(en, mask, pc, STOP_END);
+        return;
     }
+    en->waiting[pc] |= *mask;
+    en->parked[pc] = 1;
+    if (pc < en->min_wait) en->min_wait = pc;
 }
 
-// Executa o código carregado na memória simulada do Neander
-void execute(uint8_t *memory) {
-    uint8_t AC = 0;
-    int PC = 0;
-    uint8_t N = 0, Z = 0;
+// Retira o grupo que espera no menor PC. Retorna o PC, ou -1 se não há mais instâncias em execução
+int ensemble_take(Ensemble *en, Lanes *mask) {
+    int pc = en->min_wait;
+    if (pc >= MEM_SIZE) return -1;
 
-    while (PC < MEM_SIZE) {
-        uint8_t opcode = memory[PC];
-        uint8_t address = memory[PC + 1];
-        
-        // Verifica se é instrução HLT
-        if ((opcode & 0xF0) == 0xF0) {
-            PC += 1;
+    *mask = en->waiting[pc];
+    en->waiting[pc] = (Lanes){0};
+    en->parked[pc] = 0;
+    en->min_wait = MEM_SIZE;
+    for (int a = pc + 1; a < MEM_SIZE; a++) {
+        if (en->parked[a]) {
+            en->min_wait = a;
             break;
         }
-        else if ((opcode & 0xF0) == 0x60) { // Verifica se é NOT
-            PC += 1;
-        } 
-        else {  // Instruções de 2 bytes
-            PC += 2;
+    }
+    return pc;
+}
+
+// O programa escreveu em um byte de código e as lanes podem ter instruções diferentes em pc:
+// executa agora só as que são iguais à primeira lane do grupo e deixa as outras esperando em pc.
+// Retorna a lane de onde a instrução deve ser lida
+int ensemble_split(Ensemble *en, Lanes *mask, int pc) {
+    int lane = 0;
+    while (!(*mask)[lane]) lane++;
+
+    Lanes same = *mask & (Lanes)(en->memory[pc] == en->memory[pc][lane]);
+    if (pc + 1 < MEM_SIZE) same &= (Lanes)(en->memory[pc + 1] == en->memory[pc + 1][lane]);
+
+    Lanes rest = *mask & ~same;
+    if (LANES_ANY(rest)) {
+        ensemble_park(en, &rest, pc);
+        *mask = same;
+    }
+    return lane;
+}
+
+// Desconta um desvio tomado das instâncias de taken; as que já esgotaram o limite param no desvio
+void ensemble_budget(Ensemble *en, Lanes *mask, Lanes *taken, int pc) {
+    Lanes stopped = {0};
+
+    for (int i = 0; i < en->count; i++) {
+        if (!(*taken)[i]) continue;
+        if (en->vms[i].jumps_left == 0) {
+            stopped[i] = 0xFF;
+        } else {
+            en->vms[i].jumps_left--;
         }
-        
-        // Executa a instrução com base no opcode
+    }
+    if (LANES_ANY(stopped)) {
+        ensemble_finish(en, &stopped, pc, STOP_LIMIT);
+        *mask &= ~stopped;
+        *taken &= ~stopped;
+    }
+}
+
+// Laço de execução do modo conjunto. Cada instrução opera em todas as lanes do grupo atual de uma
+// vez; as outras lanes não mudam. Compilado para AVX2 e para o conjunto básico (SSE2), escolhido
+// na carga do programa conforme o processador
+#if defined(__x86_64__)
+__attribute__((target_clones("avx2", "default")))
+#endif
+void ensemble_loop(Ensemble *en, const Lanes *active) {
+    Lanes mask = *active, AC = en->AC, ran = en->ran, taken;
+    int pc = 0;
+
+    for (;;) {
+        // O grupo passou de um PC onde há instâncias esperando: junta (mesmo PC) ou troca de grupo
+        if (pc >= en->min_wait) {
+            en->AC = AC;
+            en->ran = ran;
+            ensemble_park(en, &mask, pc);
+            pc = ensemble_take(en, &mask);
+            if (pc < 0) break;
+        }
+
+        int lane = (en->uniform[pc] & en->uniform[pc + 1]) ? 0 : ensemble_split(en, &mask, pc);
+        uint8_t opcode = en->memory[pc][lane];
+        uint8_t address = pc + 1 < MEM_SIZE ? en->memory[pc + 1][lane] : 0;
+
         switch (opcode & 0xF0) {
-            case 0x10: memory[address] = AC; break;     // STA: armazena AC na memória
-            case 0x20: AC = memory[address]; break;     // LDA: carrega valor da memória para AC
-            case 0x30: AC += memory[address]; break;    // ADD: soma valor da memória ao AC
-            case 0x40: AC |= memory[address]; break;    // OR: AC |= memória
-            case 0x50: AC &= memory[address]; break;    // AND: AC &= memória
-            case 0x60: AC = ~AC; break;                 // NOT: inverte bits do AC
-            case 0x80: PC = address; break;             // JMP: desvia
-            case 0x90: if (N) PC = address; break;      // JN: desvia se negativo
-            case 0xA0: if (Z) PC = address; break;      // JZ: desvia se zero
+            case 0x10:  // STA
+                en->memory[address] = LANES_BLEND(mask, AC, en->memory[address]);
+                en->uniform[address] = 0;
+                break;
+            case 0x20: AC = LANES_BLEND(mask, en->memory[address], AC); break;          // LDA
+            case 0x30: AC = LANES_BLEND(mask, AC + en->memory[address], AC); break;     // ADD
+            case 0x40: AC = LANES_BLEND(mask, AC | en->memory[address], AC); break;     // OR
+            case 0x50: AC = LANES_BLEND(mask, AC & en->memory[address], AC); break;     // AND
+            case 0x60:  // NOT
+                AC = LANES_BLEND(mask, ~AC, AC);
+                ran |= mask;
+                pc += 1;
+                continue;
+            case 0xF0:  // HLT
+                en->AC = AC;
+                en->ran = ran;
+                ensemble_finish(en, &mask, pc + 1, STOP_HLT);
+                mask = (Lanes){0};
+                pc = MEM_SIZE;
+                continue;
+            case 0x80: taken = mask; goto jump;                                         // JMP
+            case 0x90: taken = mask & (Lanes)((SignedLanes)AC >> 7); goto jump;         // JN
+            case 0xA0: taken = mask & ran & (Lanes)(AC == 0); goto jump;                // JZ
+        }
+        ran |= mask;
+        pc += 2;
+        continue;
+
+    jump:
+        if (en->limited && LANES_ANY(taken)) {
+            en->AC = AC;
+            en->ran = ran;
+            ensemble_budget(en, &mask, &taken, pc);
+            if (!LANES_ANY(mask)) {
+                pc = MEM_SIZE;
+                continue;
+            }
+        }
+        ran |= mask;
+
+        Lanes fall = mask & ~taken;
+        if (!LANES_ANY(taken)) {
+            pc += 2;
+        } else if (!LANES_ANY(fall)) {
+            pc = address;
+        } else if (address < pc + 2) {
+            // As instâncias divergiram: continua o caminho de menor PC, o outro espera
+            ensemble_park(en, &fall, pc + 2);
+            mask = taken;
+            pc = address;
+        } else {
+            ensemble_park(en, &taken, address);
+            mask = fall;
+            pc += 2;
+        }
+    }
+}
+
+// Executa até ENSEMBLE_LANES instâncias do mesmo programa, a partir de PC 0, com as memórias em lanes
+void run_ensemble(Neander *vms, int count) {
+    Ensemble *en = aligned_alloc(sizeof(Lanes), sizeof(Ensemble));
+    Lanes mask = {0};
+    if (!en) {
+        perror("Erro de memoria");
+        exit(EXIT_FAILURE);
+    }
+    memset(en, 0, sizeof(Ensemble));
+    en->vms = vms;
+    en->count = count;
+    en->min_wait = MEM_SIZE;
+
+    // Transpõe as memórias: um vetor por endereço, com o byte de cada instância na sua lane
+    for (int i = 0; i < count; i++) {
+        mask[i] = 0xFF;
+        en->AC[i] = vms[i].AC;
+        if (vms[i].jumps_left != JUMPS_UNLIMITED) en->limited = 1;
+        for (int a = 0; a < MEM_SIZE; a++) {
+            en->memory[a][i] = vms[i].memory[a];
+        }
+    }
+    for (int a = 0; a < MEM_SIZE; a++) {
+        en->uniform[a] = 1;
+        for (int i = 1; i < count; i++) {
+            if (vms[i].memory[a] != vms[0].memory[a]) en->uniform[a] = 0;
+        }
+    }
+    en->uniform[MEM_SIZE] = 1;
+
+    ensemble_loop(en, &mask);
+
+    for (int i = 0; i < count; i++) {
+        for (int a = 0; a < MEM_SIZE; a++) {
+            vms[i].memory[a] = en->memory[a][i];
+        }
+    }
+    free(en);
+}
+
+#else
+
+// Sem extensões vetoriais do GCC, as instâncias executam uma por vez
+void run_ensemble(Neander *vms, int count) {
+    for (int i = 0; i < count; i++) {
+        neander_run_switch(&vms[i]);
+    }
+}
+
+#endif
+
+// Modo conjunto: executa o mesmo programa com cada linha do arquivo de entradas, ENSEMBLE_LANES
+// instâncias por vez, e escreve uma linha de resultado por entrada, no formato do modo em lote
+void run_ensemble_file(const Neander *image, const char *inputs, const char *output, int with_hash) {
+    static const char *stop_names[] = {"HLT", "FIM", "LIMITE"};
+    int count, *lines;
+    Neander *vms = read_inputs(inputs, image, &lines, &count);
+
+    double start = now_seconds();
+    for (int i = 0; i < count; i += ENSEMBLE_LANES) {
+        run_ensemble(&vms[i], count - i < ENSEMBLE_LANES ? count - i : ENSEMBLE_LANES);
+    }
+    double elapsed = now_seconds() - start;
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        perror("Erro ao criar arquivo de saida");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++) {
+        Neander *vm = &vms[i];
+        fprintf(out, "%s:%d\t%s\tAC=%02X\tPC=%02X\tN=%d\tZ=%d", inputs, lines[i],
+                stop_names[vm->stop], vm->AC, vm->PC, vm->N, vm->Z);
+        if (with_hash) {
+            fprintf(out, "\tHASH=%016llx", (unsigned long long)memory_hash(vm->memory));
         }
-        
-        // Atualiza flags N e Z
-        N = (AC & 0x80) ? 1 : 0;
-        Z = (AC == 0) ? 1 : 0;
+        fputc('\n', out);
     }
+    if (out != stdout) fclose(out);
 
-    printf("\n---------------------------------------------");
-    printf("\n\nMemoria apos a execucao:\n");
-    print_memory(memory);
-    printf("\nFinal:\nAC: %02X\nPC: %02X\nN: %d\nZ: %d\n", AC, PC, N, Z);
+    fprintf(stderr, "%d instancias executadas em %.3f s (%d por vetor)\n", count, elapsed, ENSEMBLE_LANES);
+    free(vms);
+    free(lines);
+}
+
+// Código de saída para o resultado de neander_execute/neander_execute_ext, com a mensagem de erro
+int execute_status(NeanderResult result) {
+    if (result == NEANDER_NO_MEMORY) {
+        fprintf(stderr, "Erro: memoria insuficiente para executar a imagem.\n");
+    } else if (result != NEANDER_OK) {
+        perror("Erro ao escrever a saida");
+    }
+    return result == NEANDER_OK ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Uso: %s <arquivo.mem>\n", argv[0]);
+    const char *filename = NULL;
+    const char *batch_source = NULL;
+    const char *ensemble_inputs = NULL;
+    const char *output = NULL;
+    EngineKind engine = ENGINE_THREADED;
+    int with_hash = 0;
+    int use_idioms = 1;
+    int jobs = 0;
+    long bench_runs = 0;
+    int profile = 0;
+    const char *profile_json = NULL;
+    uint64_t jump_limit = 0;
+    OutputFormat format = OUTPUT_VERBOSE;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--switch") == 0) {
+            engine = ENGINE_SWITCH;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            engine = ENGINE_JIT;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_runs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_source = argv[++i];
+        } else if (strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc) {
+            ensemble_inputs = argv[++i];
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[i], "--profile-json") == 0 && i + 1 < argc) {
+            profile_json = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (neander_output_format(name, &format) != 0) {
+                fprintf(stderr, "Erro: formato de saida desconhecido '%s' (use verbose, summary, diff ou binary).\n", name);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--no-idioms") == 0) {
+            use_idioms = 0;
+        } else if (strcmp(argv[i], "--hash") == 0) {
+            with_hash = 1;
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            jump_limit = strtoull(argv[++i], NULL, 10);
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (batch_source) {
+        run_batch(batch_source, output, jobs, engine, with_hash, jump_limit, use_idioms);
+        return EXIT_SUCCESS;
+    }
+
+    if (!filename) {
+        fprintf(stderr, "Uso: %s [--switch|--jit] [--no-idioms] [--limit <desvios>] [--bench <execucoes>]\n"
+                        "       [--profile] [--profile-json <arquivo>]\n"
+                        "       [--format verbose|summary|diff|binary] <arquivo.mem>\n", argv[0]);
+        fprintf(stderr, "     %s --ensemble <entradas.txt> [--hash] [--out <arquivo>] [--limit <desvios>] <arquivo.mem>\n", argv[0]);
+        fprintf(stderr, "     %s --batch <lista.txt|diretorio> [--switch|--jit] [--no-idioms] [--jobs <n>] [--hash] [--out <arquivo>] [--limit <desvios>]\n", argv[0]);
         return EXIT_FAILURE;
     }
     
-    uint8_t memory[MEM_SIZE] = {0};
-    load_memory(argv[1], memory);
+    Neander vm = {0};
+    neander_set_jump_limit(&vm, jump_limit);
+    vm.use_idioms = use_idioms;
+    if (load_memory(filename, vm.memory) == LOAD_ERR_EXTENDED) {
+        if (ensemble_inputs || bench_runs > 0 || profile || profile_json) {
+            fprintf(stderr, "Erro: imagens do modo estendido nao suportam --ensemble, --bench ou --profile.\n");
+            return EXIT_FAILURE;
+        }
+        NeanderExt ext;
+        neander_ext_init(&ext);
+        int status = neander_load_ext_image(filename, &ext);
+        if (status != LOAD_OK) {
+            neander_ext_free(&ext);
+            if (status == LOAD_ERR_MEMORY) return execute_status(NEANDER_NO_MEMORY);
+            fprintf(stderr, "Erro: O arquivo fornecido nao e um arquivo .mem valido.\n");
+            return EXIT_FAILURE;
+        }
+        ext.jumps_left = jump_limit ? jump_limit : JUMPS_UNLIMITED;
+        status = execute_status(neander_execute_ext(&ext, format, NULL));
+        neander_ext_free(&ext);
+        return status;
+    }
 
-    printf("Memoria antes da execucao:\n");
-    print_memory(memory);
-    execute(memory);
+    if (ensemble_inputs) {
+        run_ensemble_file(&vm, ensemble_inputs, output, with_hash);
+        return EXIT_SUCCESS;
+    }
 
-    return EXIT_SUCCESS;
+    if (bench_runs > 0) {
+        benchmark(&vm, bench_runs);
+        return EXIT_SUCCESS;
+    }
+
+    // O perfil usa o interpretador de referência, que executa uma instrução por vez
+    if (profile || profile_json) {
+        Profile *p = calloc(1, sizeof(Profile));
+        uint8_t image[MEM_SIZE];
+        if (!p) {
+            perror("Erro de memoria");
+            return EXIT_FAILURE;
+        }
+        memcpy(image, vm.memory, MEM_SIZE);
+        int status = execute_status(neander_execute(&vm, engine, format, p, NULL));
+        if (status == EXIT_SUCCESS && profile) print_profile(p, image);
+        if (status == EXIT_SUCCESS && profile_json) write_profile_json(p, image, profile_json);
+        free(p);
+        return status;
+    }
+    return execute_status(neander_execute(&vm, engine, format, NULL, NULL));
 }
\ No newline at end of file
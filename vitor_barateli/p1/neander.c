@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "neander.h"
+
+// Executa programas de alto nível direto: compila, monta e executa em memória com a libneander,
+// sem gerar os arquivos intermediários (assembly e .mem). No modo servidor os programas chegam
+// como pedidos pela entrada padrão ou por um socket Unix, e um processo atende todos eles
+
+#define MAX_REQUEST (16 * 1024 * 1024)  // Maior conteúdo aceito em um pedido do modo servidor
+#define MAX_TOKENS 32                   // Palavras do cabeçalho de um pedido
+
+// Opções da linha de comando, que também valem para cada pedido do modo servidor
+typedef struct {
+    CompileOptions options;
+    EngineKind engine;
+    OutputFormat format;
+    int use_idioms;
+    uint64_t jump_limit;
+    ImageFormat image_format;   // Imagem devolvida pelo pedido "assemble"
+    const char *superopt_file;
+} Settings;
+
+// Lê as opções em args; o que não é opção vai para rest. Retorna 0, ou -1 com a mensagem do primeiro erro em
+// error. Depois de um erro as opções continuam sendo lidas, para que o servidor ainda encontre o tamanho do pedido
+int parse_options(int count, char **args, Settings *s, const char **rest, int *rest_count,
+                  char *error, size_t error_size) {
+    int status = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(args[i], "--switch") == 0) {
+            s->engine = ENGINE_SWITCH;
+        } else if (strcmp(args[i], "--jit") == 0) {
+            s->engine = ENGINE_JIT;
+        } else if (strcmp(args[i], "--no-idioms") == 0) {
+            s->use_idioms = 0;
+        } else if (strcmp(args[i], "--no-peephole") == 0) {
+            s->options.no_peephole = 1;
+        } else if (strcmp(args[i], "--no-layout") == 0) {
+            s->options.no_layout = 1;
+        } else if (strcmp(args[i], "--ext") == 0) {
+            s->options.extended = 1;
+        } else if (strcmp(args[i], "--no-fold") == 0) {
+            s->options.no_fold = 1;
+        } else if (strcmp(args[i], "--calls") == 0) {
+            s->options.calls = CALLS_ALWAYS;
+        } else if (strcmp(args[i], "--inline") == 0) {
+            s->options.calls = CALLS_NEVER;
+        } else if (strcmp(args[i], "--compact") == 0) {
+            s->image_format = FORMAT_COMPACT;
+        } else if (strcmp(args[i], "--sparse") == 0) {
+            s->image_format = FORMAT_SPARSE;
+        } else if (strcmp(args[i], "--superopt") == 0 && i + 1 < count) {
+            s->superopt_file = args[++i];
+        } else if (strcmp(args[i], "--limit") == 0 && i + 1 < count) {
+            s->jump_limit = strtoull(args[++i], NULL, 10);
+        } else if (strcmp(args[i], "--format") == 0 && i + 1 < count) {
+            const char *name = args[++i];
+            if (neander_output_format(name, &s->format) != 0 && status == 0) {
+                snprintf(error, error_size, "formato de saida desconhecido '%s' (use verbose, summary, diff ou binary)", name);
+                status = -1;
+            }
+        } else {
+            rest[(*rest_count)++] = args[i];
+        }
+    }
+    return status;
+}
+
+// Converte o resultado de neander_execute/neander_execute_ext: retorna 0, ou -1 com a mensagem em error
+int execute_status(NeanderResult result, char *error, size_t error_size) {
+    if (result == NEANDER_NO_MEMORY) snprintf(error, error_size, "memoria insuficiente");
+    else if (result != NEANDER_OK) snprintf(error, error_size, "erro ao escrever o relatorio");
+    return result == NEANDER_OK ? 0 : -1;
+}
+
+// Executa uma imagem e acrescenta o relatório em out (NULL: saída padrão). Retorna 0, ou -1 com a
+// mensagem em error se a imagem é inválida ou a execução falhou
+int run_image(const NeanderBuffer *image, const Settings *s, NeanderBuffer *out, char *error, size_t error_size) {
+    Neander vm = {0};
+    int loaded = neander_load_image_data((const uint8_t *)image->data, image->len, vm.memory);
+    if (loaded == LOAD_ERR_EXTENDED) {
+        NeanderExt ext;
+        neander_ext_init(&ext);
+        loaded = neander_load_ext_image_data((const uint8_t *)image->data, image->len, &ext);
+        if (loaded != LOAD_OK) {
+            neander_ext_free(&ext);
+            snprintf(error, error_size, loaded == LOAD_ERR_MEMORY ? "memoria insuficiente" : "imagem invalida");
+            return -1;
+        }
+        ext.jumps_left = s->jump_limit ? s->jump_limit : JUMPS_UNLIMITED;
+        NeanderResult result = neander_execute_ext(&ext, s->format, out);
+        neander_ext_free(&ext);
+        return execute_status(result, error, error_size);
+    }
+    if (loaded != LOAD_OK) {
+        snprintf(error, error_size, "imagem invalida");
+        return -1;
+    }
+    neander_set_jump_limit(&vm, s->jump_limit);
+    vm.use_idioms = s->use_idioms;
+    return execute_status(neander_execute(&vm, s->engine, s->format, NULL, out), error, error_size);
+}
+
+// Compila, monta e executa o programa em source (name: arquivo citado nas mensagens, ou NULL).
+// Retorna 0, ou -1 com a mensagem em error
+int run_source(const NeanderBuffer *source, const char *name, const Settings *s, NeanderBuffer *out,
+               char *error, size_t error_size) {
+    NeanderBuffer assembly = {0}, image = {0};
+    char detail[256];
+    int status = -1;
+
+    if (neander_compile(source->data, source->len, &s->options, &assembly, detail, sizeof(detail)) != 0) {
+        snprintf(error, error_size, "Erro de compilacao%s%s: %s", name ? " em " : "", name ? name : "", detail);
+    } else if (neander_assemble(assembly.data, assembly.len, FORMAT_COMPACT, s->options.extended, &image, detail, sizeof(detail)) != 0) {
+        snprintf(error, error_size, "Erro de montagem%s%s: %s", name ? " em " : "", name ? name : "", detail);
+    } else {
+        status = run_image(&image, s, out, error, error_size);
+    }
+    neander_buffer_free(&assembly);
+    neander_buffer_free(&image);
+    return status;
+}
+
+// Compila, monta e executa um arquivo. Retorna 0, ou -1 se alguma etapa falhou
+int run_program(const char *filename, const Settings *s) {
+    NeanderBuffer source = {0};
+    char error[512];
+
+    if (neander_read_file(filename, &source) != 0) {
+        perror("Erro ao abrir arquivo de entrada");
+        return -1;
+    }
+    int status = run_source(&source, filename, s, NULL, error, sizeof(error));
+    if (status != 0) fprintf(stderr, "%s\n", error);
+    neander_buffer_free(&source);
+    return status;
+}
+
+// Atende um pedido: command sobre o conteúdo em input, com a resposta em out.
+// Retorna 0, ou -1 com a mensagem em error
+int serve_request(const char *command, const NeanderBuffer *input, const Settings *s, NeanderBuffer *out,
+                  char *error, size_t error_size) {
+    char detail[256];
+
+    if (strcmp(command, "compile") == 0) {
+        if (neander_compile(input->data, input->len, &s->options, out, detail, sizeof(detail)) == 0) return 0;
+        snprintf(error, error_size, "Erro de compilacao: %s", detail);
+        return -1;
+    }
+    if (strcmp(command, "assemble") == 0) {
+        if (neander_assemble(input->data, input->len, s->image_format, s->options.extended, out, detail, sizeof(detail)) == 0) return 0;
+        snprintf(error, error_size, "Erro de montagem: %s", detail);
+        return -1;
+    }
+    if (strcmp(command, "run") == 0) return run_source(input, NULL, s, out, error, error_size);
+    if (strcmp(command, "exec") == 0) return run_image(input, s, out, error, error_size);
+
+    snprintf(error, error_size, "pedido desconhecido '%s' (use compile, assemble, run ou exec)", command);
+    return -1;
+}
+
+// Escreve uma resposta: "OK <tamanho>" ou "ERRO <tamanho>", uma quebra de linha e o conteúdo
+int write_response(FILE *out, const char *status, const char *data, size_t len) {
+    fprintf(out, "%s %zu\n", status, len);
+    fwrite(data, 1, len, out);
+    return fflush(out) == 0 ? 0 : -1;
+}
+
+// Lê e descarta len bytes de in. Retorna quantos foram lidos
+size_t skip_input(FILE *in, size_t len) {
+    char chunk[8192];
+    size_t done = 0, n;
+
+    while (done < len && (n = fread(chunk, 1, len - done < sizeof(chunk) ? len - done : sizeof(chunk), in)) > 0) {
+        done += n;
+    }
+    return done;
+}
+
+// Atende pedidos de in até o fim da entrada. Cada pedido é uma linha "<pedido> [opções] <tamanho>"
+// seguida de <tamanho> bytes de conteúdo; as opções se somam às da linha de comando.
+// Retorna 0, ou -1 se a conexão ficou fora de sincronia (cabeçalho inválido ou conteúdo incompleto)
+int serve(FILE *in, FILE *out, const Settings *defaults) {
+    char header[1024];
+
+    while (fgets(header, sizeof(header), in)) {
+        char *tokens[MAX_TOKENS];
+        int token_count = 0;
+        for (char *t = strtok(header, " \t\r\n"); t && token_count < MAX_TOKENS; t = strtok(NULL, " \t\r\n")) {
+            tokens[token_count++] = t;
+        }
+        if (token_count == 0) continue;
+
+        // Opções do pedido; sobram o nome do pedido e o tamanho
+        Settings s = *defaults;
+        const char *rest[MAX_TOKENS];
+        int rest_count = 0;
+        char error[512];
+        int status = parse_options(token_count - 1, tokens + 1, &s, rest, &rest_count, error, sizeof(error));
+
+        char *end;
+        unsigned long len = rest_count == 1 ? strtoul(rest[0], &end, 10) : 0;
+        if (rest_count != 1 || *end != '\0' || len > MAX_REQUEST) {
+            static const char message[] = "cabecalho invalido (use: <pedido> [opcoes] <tamanho>)";
+            write_response(out, "ERRO", message, sizeof(message) - 1);
+            return -1;
+        }
+
+        // Sem memória para o conteúdo ele é descartado, para que o próximo pedido continue em sincronia
+        NeanderBuffer input = {0}, result = {0};
+        if (neander_buffer_reserve(&input, len) == 0) {
+            input.len = fread(input.data, 1, len, in);
+            input.data[input.len] = '\0';
+        } else {
+            input.len = skip_input(in, len);
+            if (status == 0) snprintf(error, sizeof(error), "memoria insuficiente");
+            status = -1;
+        }
+        if (input.len != len) {
+            neander_buffer_free(&input);
+            return -1;
+        }
+
+        if (status == 0 && s.superopt_file != defaults->superopt_file) {
+            snprintf(error, sizeof(error), "--superopt so vale na linha de comando");
+            status = -1;
+        }
+        if (status == 0) status = serve_request(tokens[0], &input, &s, &result, error, sizeof(error));
+
+        int written = status == 0 ? write_response(out, "OK", result.data, result.len)
+                                  : write_response(out, "ERRO", error, strlen(error));
+        neander_buffer_free(&input);
+        neander_buffer_free(&result);
+        if (written != 0) return -1;
+    }
+    return 0;
+}
+
+// Atende conexões em um socket Unix, uma de cada vez, até o processo ser encerrado
+int serve_socket(const char *path, const Settings *defaults) {
+    struct sockaddr_un addr = {0};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Erro: caminho do socket muito longo '%s'\n", path);
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("Erro ao criar o socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 16) != 0) {
+        perror("Erro ao abrir o socket");
+        close(listener);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);   // Um cliente que desconecta no meio da resposta não encerra o servidor
+
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            perror("Erro ao aceitar conexao");
+            continue;
+        }
+        int write_fd = dup(fd);
+        FILE *in = fdopen(fd, "rb");
+        FILE *out = write_fd >= 0 ? fdopen(write_fd, "wb") : NULL;
+        if (in && out) serve(in, out, defaults);
+        if (in) fclose(in); else close(fd);
+        if (out) fclose(out); else if (write_fd >= 0) close(write_fd);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *files[argc];
+    int file_count = 0;
+    Settings settings = {0};
+    SuperoptDb superopt = {0};
+    char error[256];
+    int server = 0;
+    const char *socket_path = NULL;
+
+    settings.engine = ENGINE_THREADED;
+    settings.format = OUTPUT_VERBOSE;
+    settings.use_idioms = 1;
+    settings.image_format = FORMAT_PADDED;
+
+    // --server e --socket só valem na linha de comando; as demais opções passam por parse_options
+    char *args[argc];
+    int arg_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0) {
+            server = 1;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            server = 1;
+            socket_path = argv[++i];
+        } else {
+            args[arg_count++] = argv[i];
+        }
+    }
+    if (parse_options(arg_count, args, &settings, files, &file_count, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Erro: %s.\n", error);
+        return EXIT_FAILURE;
+    }
+
+    if ((file_count == 0) != server) {
+        fprintf(stderr, "Uso: %s [--switch|--jit] [--no-idioms] [--no-peephole] [--no-layout] [--no-fold] [--calls|--inline]\n"
+                        "       [--superopt <superopt.db>] [--limit <desvios>] [--ext] [--format verbose|summary|diff|binary] <programa.txt>...\n"
+                        "     %s --server|--socket <caminho> [opcoes]\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // O banco é lido uma vez e vale para todos os programas
+    if (settings.superopt_file) {
+        NeanderBuffer db = {0};
+        if (neander_read_file(settings.superopt_file, &db) != 0) {
+            perror("Erro ao abrir o banco do superotimizador");
+            return EXIT_FAILURE;
+        }
+        if (neander_superopt_parse(db.data, db.len, &superopt, error, sizeof(error)) != 0) {
+            fprintf(stderr, "Erro: %s\n", error);
+            return EXIT_FAILURE;
+        }
+        neander_buffer_free(&db);
+        settings.options.superopt = &superopt;
+    }
+
+    int failed = 0;
+    if (socket_path) {
+        failed = serve_socket(socket_path, &settings) != 0;
+    } else if (server) {
+        failed = serve(stdin, stdout, &settings) != 0;
+    }
+    for (int i = 0; i < file_count; i++) {
+        if (file_count > 1) {
+            printf("Programa: %s\n", files[i]);
+            fflush(stdout);     // O relatório é escrito direto no descritor
+        }
+        if (run_program(files[i], &settings) != 0) failed = 1;
+    }
+    neander_superopt_free(&superopt);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,325 @@
+#ifndef NEANDER_H
+#define NEANDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// libneander: compilador, montador e máquina Neander em uma biblioteca.
+// Nenhuma função guarda estado global: o compilador e o montador trabalham sobre buffers em memória
+// (texto do programa -> texto do assembly -> imagem) e cada execução usa a sua instância da máquina.
+// A única exceção é o cache de traduções do JIT, que é separado por thread
+
+#define MEM_SIZE 256    // Define o tamanho da memória da máquina Neander (256 bytes)
+#define MAGIC_HEADER {0x03, 0x4E, 0x44, 0x52}   // // Define o cabeçalho mágico esperado nos arquivos .mem
+#define HEADER_SIZE 4
+
+// Formato compacto de imagem (gerado por "assembler --compact" ou "--sparse"):
+//   0  4  cabeçalho 03 4E 44 43
+//   4  1  versão (COMPACT_VERSION)
+//   5  1  flags (COMPACT_SPARSE, COMPACT_EXTENDED)
+//   6  2  reservado (0)
+//   8  4  denso: quantidade de bytes da memória; esparso: quantidade de trechos (LE32)
+//  12  .. denso: os bytes da memória sem separadores, zeros finais omitidos
+//         esparso: trechos [endereço LE16][tamanho LE16][bytes]
+#define COMPACT_HEADER {0x03, 0x4E, 0x44, 0x43}
+#define COMPACT_HEADER_SIZE 12
+#define COMPACT_VERSION 1
+#define COMPACT_SPARSE 0x01
+#define COMPACT_EXTENDED 0x02   // Imagem do modo estendido (ver NeanderExt)
+#define SPARSE_MIN_GAP 4        // Zeros seguidos a partir dos quais o montador começa outro trecho
+#define RUN_MAX 0xFFFF          // Maior trecho do formato esparso (tamanho em 16 bits)
+
+// Modo estendido ("assembler --ext"): 64 KiB de memória e operandos de 16 bits (little-endian),
+// ou seja, instruções com operando ocupam 3 bytes. NOT e HLT continuam com 1 byte
+#define EXT_MEM_SIZE 65536
+#define EXT_PAGE_SIZE 256
+#define EXT_PAGES (EXT_MEM_SIZE / EXT_PAGE_SIZE)
+
+#define JUMPS_UNLIMITED UINT64_MAX
+
+// Resultado das funções da biblioteca que podem falhar. Nenhuma delas encerra o processo:
+// a falta de memória também volta como resultado
+typedef enum {
+    NEANDER_OK = 0,
+    NEANDER_ERROR = -1,         // Entrada inválida ou erro de escrita (mensagem em error, quando há uma)
+    NEANDER_NO_MEMORY = -2      // Uma alocação falhou; o que foi escrito na saída está incompleto
+} NeanderResult;
+
+// Erros possíveis ao carregar uma imagem
+#define LOAD_OK 0
+#define LOAD_ERR_OPEN -1    // Arquivo não pôde ser aberto
+#define LOAD_ERR_FORMAT -2  // Cabeçalho inválido
+#define LOAD_ERR_EXTENDED -3    // Imagem do modo estendido (carregar com neander_load_ext_image)
+#define LOAD_ERR_MEMORY -4      // Sem memória para as páginas do modo estendido
+
+// Motivo pelo qual a execução terminou
+typedef enum {
+    STOP_HLT,       // Instrução HLT
+    STOP_END,       // PC passou do fim da memória
+    STOP_LIMIT      // Limite de desvios tomados atingido
+} StopReason;
+
+// Estado de uma instância da máquina Neander. Cada imagem executada possui a sua,
+// o que permite executar várias imagens ao mesmo tempo em threads diferentes
+typedef struct {
+    uint8_t memory[MEM_SIZE];
+    uint8_t AC;
+    int PC;
+    uint8_t N, Z;
+    uint64_t jumps_left;    // Desvios tomados ainda permitidos (JUMPS_UNLIMITED = sem limite)
+    StopReason stop;
+    int use_idioms;         // Substituir laços de multiplicação/soma contada por passos em O(1)
+    uint32_t idioms_found;          // Laços reconhecidos durante a execução
+    uint64_t idioms_applied;        // Vezes que um laço foi substituído pelo passo em O(1)
+    uint64_t iterations_skipped;    // Iterações que deixaram de ser executadas
+} Neander;
+
+// Estado de uma instância do modo estendido. A memória é dividida em páginas de 256 bytes
+// alocadas só na primeira escrita; as páginas nunca escritas apontam para uma página de zeros compartilhada
+typedef struct {
+    uint8_t *pages[EXT_PAGES];
+    int pages_used;
+    uint8_t AC;
+    uint32_t PC;
+    uint8_t N, Z;
+    uint64_t jumps_left;
+    StopReason stop;
+    int failed;         // Uma página não pôde ser alocada (a execução para no STA que a escreveria)
+} NeanderExt;
+
+// Formatos do relatório de uma execução
+typedef enum {
+    OUTPUT_VERBOSE,     // Memória inteira antes e depois, com mnemônicos (padrão)
+    OUTPUT_SUMMARY,     // Só o motivo da parada e os registradores finais
+    OUTPUT_DIFF,        // Só as posições de memória alteradas, e os registradores
+    OUTPUT_BINARY       // Memória final (256 bytes) seguida de AC, PC (2 bytes, LE), N e Z
+} OutputFormat;
+
+typedef enum {
+    ENGINE_THREADED,    // Imagem pré-decodificada com despacho por computed goto (padrão)
+    ENGINE_SWITCH,      // Interpretador de referência
+    ENGINE_JIT          // Tradução de blocos básicos para x86-64
+} EngineKind;
+
+// Formatos de arquivo binário gerados pelo montador
+typedef enum {
+    FORMAT_PADDED,  // Formato original do Neander, com separador 0x00 após cada byte
+    FORMAT_COMPACT, // Cabeçalho compacto com a memória em sequência
+    FORMAT_SPARSE   // Cabeçalho compacto com trechos não nulos prefixados por endereço e tamanho
+} ImageFormat;
+
+// Contadores coletados pelo modo de perfil
+typedef struct {
+    uint64_t total;                 // Instruções executadas
+    uint64_t exec[MEM_SIZE];        // Execuções por PC
+    uint64_t taken[MEM_SIZE];       // Desvios tomados por PC (JMP/JN/JZ)
+    uint64_t not_taken[MEM_SIZE];   // JN/JZ não tomados por PC
+    uint64_t reads[MEM_SIZE];       // Leituras de dados por endereço (LDA/ADD/OR/AND)
+    uint64_t writes[MEM_SIZE];      // Escritas por endereço (STA)
+    uint8_t target[MEM_SIZE];       // Último destino de cada desvio tomado
+} Profile;
+
+// Buffer de bytes que cresce conforme a necessidade (texto do assembly ou imagem gerada)
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+    int failed;         // Uma alocação falhou: o conteúdo está incompleto e nada mais é acrescentado
+} NeanderBuffer;
+
+// Arena: blocos de memória de onde saem objetos que são liberados todos juntos (nós da árvore sintática)
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+    int failed;
+} Arena;
+
+// neander_buffer.c: neander_alloc é a única alocação da biblioteca; sem memória devolve NULL e marca
+// *failed (os buffers e listas guardam essa marca e a operação que os usa devolve NEANDER_NO_MEMORY)
+void *neander_alloc(void *p, size_t count, size_t size, int *failed);
+void *neander_arena_alloc(Arena *arena, size_t size);
+char *neander_arena_strdup(Arena *arena, const char *s);
+void neander_arena_free(Arena *arena);
+int neander_buffer_reserve(NeanderBuffer *b, size_t extra);
+void neander_buffer_append(NeanderBuffer *b, const void *data, size_t len);
+void neander_buffer_printf(NeanderBuffer *b, const char *format, ...);
+void neander_buffer_free(NeanderBuffer *b);
+int neander_read_file(const char *filename, NeanderBuffer *out);
+
+// Código gerado pelo compilador, antes de receber endereços. Os desvios apontam para rótulos
+// (OP_LABEL), que só viram endereços quando o assembly é escrito (neander_code_write)
+#define MAX_OPERAND_LEN 100
+
+typedef enum {
+    OP_NOP, OP_STA, OP_LDA, OP_ADD, OP_OR, OP_AND, OP_NOT, OP_JMP, OP_JN, OP_JZ, OP_HLT,
+    OP_LABEL,   // Pseudo-instrução que define o rótulo target nesta posição (não ocupa memória)
+    OP_RET      // Retorno de sub-rotina: JMP cujo operando é escrito pelo chamador (ver STA com target)
+} Op;
+
+// Sub-rotinas: o Neander não tem CALL, então o chamador grava o endereço de retorno no operando do
+// OP_RET (STA com target = rótulo logo antes do OP_RET) e desvia para a sub-rotina. O endereço de
+// retorno vem de uma variável do .DATA, preenchida por neander_code_export_labels com o endereço de um
+// rótulo exportado (OP_LABEL com operand = nome da variável)
+typedef struct {
+    Op op;
+    int target;                     // Rótulo de destino (desvios), definido (OP_LABEL) ou cujo operando é escrito (STA)
+    char operand[MAX_OPERAND_LEN];  // Variável (STA, LDA, ADD, OR, AND) ou variável que recebe o endereço (OP_LABEL)
+} Instr;
+
+typedef struct {
+    Instr *items;
+    int count;
+    int capacity;
+    int labels;     // Rótulos criados
+    int failed;     // Uma alocação falhou (a lista ou uma passada do otimizador ficou incompleta)
+} CodeList;
+
+// neander_code.c: lista de instruções e otimizador peephole
+extern const char *neander_op_names[];     // Mnemônicos, na ordem de Op (até OP_HLT)
+int neander_code_new_label(CodeList *code);
+void neander_code_append(CodeList *code, Op op, const char *operand);
+void neander_code_jump(CodeList *code, Op op, int label);
+void neander_code_place_label(CodeList *code, int label);
+void neander_code_export_label(CodeList *code, int label, const char *name);
+void neander_code_patch(CodeList *code, int label);
+int neander_is_jump(Op op);
+int neander_reads_operand(Op op);
+int neander_code_filter(CodeList *code, const char *keep);
+void neander_code_peephole(CodeList *code);
+void neander_code_write(const CodeList *code, int extended, NeanderBuffer *out);
+void neander_code_free(CodeList *code);
+
+// Declaração do .DATA gerada pelo compilador
+typedef struct {
+    char name[MAX_OPERAND_LEN];
+    char value[MAX_OPERAND_LEN];    // Texto do valor ("?" se não inicializada)
+    int temporary;                  // Auxiliar criada pelo compilador (_T0, _UM...), pode dividir posição com outras
+} DataDecl;
+
+typedef struct {
+    DataDecl *items;
+    int count;
+    int capacity;
+    int failed;
+} DataList;
+
+// neander_layout.c: declarações do .DATA e distribuição das auxiliares na memória
+void neander_data_append(DataList *data, const char *name, const char *value, int temporary);
+void neander_data_write(const DataList *data, NeanderBuffer *out);
+void neander_data_free(DataList *data);
+uint8_t neander_initial_value(const DataDecl *decl);
+void neander_code_layout(CodeList *code, DataList *data);
+
+// neander_code.c: grava nas variáveis dos rótulos exportados os endereços que neander_code_write vai usar
+void neander_code_export_labels(const CodeList *code, int extended, DataList *data);
+
+// Escolha entre gerar cada multiplicação e divisão no lugar ou chamar uma sub-rotina compartilhada
+typedef enum {
+    CALLS_AUTO,     // Pelo modelo de custo (tamanho e instruções executadas)
+    CALLS_ALWAYS,   // Sempre sub-rotinas (menor código)
+    CALLS_NEVER     // Sempre no lugar (mais rápido)
+} CallMode;
+
+// Saída do compilador
+typedef enum {
+    TARGET_NEANDER, // Assembly do Neander (padrão)
+    TARGET_C,       // Programa em C com a mesma aritmética de 8 bits, para compilar com cc
+    TARGET_X86      // Assembly x86-64 (GNU as, sintaxe Intel) do mesmo programa, para montar com cc
+} CompileTarget;
+
+// Banco do superotimizador (superopt.db, gerado por ./superopt): para cada padrão de expressão, a menor
+// sequência de instruções sem desvios encontrada que deixa o valor no AC. Uma linha por padrão:
+//   (x%4) = LDA x; AND #3
+// O padrão é a expressão com parênteses, com as folhas chamadas x, y e z na ordem em que aparecem e os
+// valores conhecidos em decimal. Nas instruções, x, y e z são as folhas, t uma temporária e #v a constante v
+#define SUPEROPT_PATTERN_LEN 32
+#define SUPEROPT_MAX_LEN 12
+
+typedef struct {
+    Op op;              // OP_LDA, OP_ADD, OP_OR, OP_AND, OP_NOT ou OP_STA
+    char operand;       // 'x', 'y', 'z', 't', '#' (constante value) ou 0 (NOT)
+    uint8_t value;
+} SuperoptInstr;
+
+typedef struct {
+    char pattern[SUPEROPT_PATTERN_LEN];
+    SuperoptInstr code[SUPEROPT_MAX_LEN];
+    int length;
+} SuperoptEntry;
+
+typedef struct {
+    SuperoptEntry *items;       // Em ordem de padrão (busca binária)
+    int count;
+    int capacity;
+} SuperoptDb;
+
+// neander_superopt.c: lê o banco em source. Retorna NEANDER_OK, ou um erro com a mensagem em error
+NeanderResult neander_superopt_parse(const char *source, size_t len, SuperoptDb *db, char *error, size_t error_size);
+const SuperoptEntry *neander_superopt_find(const SuperoptDb *db, const char *pattern);
+void neander_superopt_free(SuperoptDb *db);
+
+// Cache de resultados em um diretório local (neander_cache.c)
+#define CACHE_DEFAULT_SIZE (64ull * 1024 * 1024)    // Limite padrão do diretório, em bytes
+
+typedef struct {
+    const char *dir;
+    uint64_t max_bytes;     // Acima disso as entradas usadas há mais tempo são removidas (0: sem limite)
+} NeanderCache;
+
+// neander_cache.c: a chave de um resultado é montada com neander_cache_key_version e neander_cache_key_add (versão,
+// opções e entrada) e guardada junto com o resultado
+void neander_cache_key_add(NeanderBuffer *key, const void *data, size_t len);
+void neander_cache_key_version(NeanderBuffer *key, const char *argv0);
+int neander_cache_get(const NeanderCache *cache, const NeanderBuffer *key, const char *ext, NeanderBuffer *out);
+int neander_cache_put(const NeanderCache *cache, const NeanderBuffer *key, const char *ext, const NeanderBuffer *data);
+int neander_cache_print_stats(const NeanderCache *cache);
+
+// Opções do compilador (zeradas = padrão)
+typedef struct {
+    int no_peephole;    // Não otimizar o código gerado (útil para comparar resultados)
+    int no_layout;      // Uma posição por auxiliar declarada, como antes da passada de layout
+    int extended;       // Modo estendido: gera .EXT e calcula os endereços com operandos de 2 bytes
+    int no_fold;        // Não calcular na compilação as subexpressões com variáveis de valor conhecido
+    CallMode calls;     // Multiplicações e divisões em linha ou em sub-rotinas compartilhadas
+    const SuperoptDb *superopt;     // Sequências do superotimizador para os padrões conhecidos (NULL: não usar)
+    CompileTarget target;           // Neander, ou um executável nativo (ver native_write)
+} CompileOptions;
+
+// neander_compiler.c: compila o programa em source e acrescenta o assembly em out.
+// options pode ser NULL. Retorna NEANDER_OK, ou um erro com a mensagem em error
+NeanderResult neander_compile(const char *source, size_t len, const CompileOptions *options, NeanderBuffer *out,
+                    char *error, size_t error_size);
+// Calcula l op r como o código gerado calcula (usada também pelo superotimizador)
+uint8_t neander_fold_binary(char op, uint8_t l, uint8_t r);
+
+// neander_assembler.c: monta o assembly em source e acrescenta a imagem no formato pedido em image.
+// extended força o modo estendido (também ativado pela diretiva .EXT).
+// Retorna NEANDER_OK, ou um erro com a mensagem em error
+NeanderResult neander_assemble(const char *source, size_t len, ImageFormat format, int extended, NeanderBuffer *image,
+                     char *error, size_t error_size);
+
+// neander_vm.c: carga de imagens
+const char* neander_get_mnemonic(uint8_t opcode);
+int neander_should_skip_next(const char* mnemonic);
+int neander_load_image_data(const uint8_t *data, size_t size, uint8_t *memory);
+int neander_load_ext_image_data(const uint8_t *data, size_t size, NeanderExt *vm);
+int neander_load_image(const char *filename, uint8_t *memory);
+int neander_load_ext_image(const char *filename, NeanderExt *vm);
+void neander_ext_init(NeanderExt *vm);
+void neander_ext_free(NeanderExt *vm);
+
+// neander_vm.c: execução
+void neander_set_jump_limit(Neander *vm, uint64_t limit);
+uint64_t neander_run_switch(Neander *vm);
+void neander_run_engine(Neander *vm, EngineKind engine);
+void neander_ext_interpret(NeanderExt *vm);
+
+// neander_vm.c: relatórios
+int neander_output_format(const char *name, OutputFormat *format);
+// out: buffer que recebe o relatório (NULL: saída padrão). Retornam NEANDER_OK, NEANDER_ERROR se o
+// relatório não pôde ser escrito, ou NEANDER_NO_MEMORY (relatório ou páginas do modo estendido)
+NeanderResult neander_execute(Neander *vm, EngineKind engine, OutputFormat format, Profile *prof, NeanderBuffer *out);
+NeanderResult neander_execute_ext(NeanderExt *vm, OutputFormat format, NeanderBuffer *out);
+
+#endif
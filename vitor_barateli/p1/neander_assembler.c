@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <setjmp.h>
+
+#include "neander.h"
+
+#define FILE_HEADER {0x03, 0x4E, 0x44, 0x52}
+
+// Estrutura para armazenar variáveis
+typedef struct {
+    char *name;
+    int address;
+    int value;
+    int initialized;
+} Variable;
+
+// Referência a um símbolo no código, resolvida quando a posição das variáveis é conhecida
+typedef struct {
+    int position;   // Endereço do operando no código
+    int name;       // Deslocamento do texto do operando em fixup_names
+} Fixup;
+
+// Estado de uma montagem. Tudo que era global fica aqui, para que várias montagens
+// possam acontecer ao mesmo tempo no mesmo processo
+typedef struct {
+    uint8_t memory[EXT_MEM_SIZE];   // Memória da máquina (os separadores 0x00 do .mem são acrescentados na escrita)
+    int code_size;                  // Tamanho do .CODE para saber em qual endereço começar a salvar as variaveis
+    int extended;                   // Modo estendido (--ext ou diretiva .EXT): operandos de 2 bytes
+
+    Variable *variables;
+    int variable_count;
+    int variable_capacity;
+
+    // Tabela hash dos símbolos (endereçamento aberto com sondagem linear)
+    // Cada posição guarda o índice da variável em variables[] + 1, ou 0 se está vazia
+    int *symbol_table;
+    int symbol_capacity;    // Sempre potência de 2
+
+    Fixup *fixups;
+    int fixup_count;
+    int fixup_capacity;
+    char *fixup_names;      // Textos dos operandos, separados por '\0'
+    size_t fixup_names_len;
+    size_t fixup_names_capacity;
+
+    NeanderBuffer line;     // Linha em leitura (qualquer tamanho)
+
+    jmp_buf fail;           // Retorno para neander_assemble em caso de erro
+    int failed;             // O erro foi falta de memória
+    char *error;
+    size_t error_size;
+} Assembler;
+
+// Mnemônicos em uma tabela hash perfeita: (segundo caractere + último caractere) % 32
+// não colide para nenhum dos 11 mnemônicos, então basta uma comparação por busca
+#define MNEMONIC_TABLE_SIZE 32
+#define MNEMONIC_HASH(s, len) (((unsigned char)(s)[1] + (unsigned char)(s)[(len) - 1]) % MNEMONIC_TABLE_SIZE)
+
+struct Mnemonic {
+    const char *mnemonic;
+    uint8_t opcode;
+    int has_operand;    // Verificar se o mnemonico ocupa 2 endereços ou não, como no caso do NOP, NOT e HLT
+};
+
+static const struct Mnemonic mnemonics[MNEMONIC_TABLE_SIZE] = {
+    [31] = {"NOP", 0x00, 0}, [21] = {"STA", 0x10, 1}, [5] = {"LDA", 0x20, 1}, [8] = {"ADD", 0x30, 1},
+    [4] = {"OR", 0x40, 1}, [18] = {"AND", 0x50, 1}, [3] = {"NOT", 0x60, 0}, [29] = {"JMP", 0x80, 1},
+    [28] = {"JN", 0x90, 1}, [20] = {"JZ", 0xA0, 1}, [0] = {"HLT", 0xF0, 0}
+};
+
+// Registra a mensagem de erro e abandona a montagem (volta para neander_assemble)
+static void assemble_error(Assembler *a, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(a->error, a->error_size, format, args);
+    va_end(args);
+    longjmp(a->fail, 1);
+}
+
+// Realoca p para count elementos de size bytes; sem memória abandona a montagem (p continua válido
+// e é liberado por assembler_free)
+static void *assemble_alloc(Assembler *a, void *p, size_t count, size_t size) {
+    void *q = neander_alloc(p, count, size, &a->failed);
+    if (!q) assemble_error(a, "memoria insuficiente");
+    return q;
+}
+
+// Função para fornecer o opcode do mnemonico
+static uint8_t get_opcode(const char *mnemonic, int *has_operand) {
+    size_t len = strlen(mnemonic);
+    if (len < 2 || len > 3) return 0xFF;
+
+    const struct Mnemonic *m = &mnemonics[MNEMONIC_HASH(mnemonic, len)];
+    if (!m->mnemonic || strcmp(mnemonic, m->mnemonic) != 0) return 0xFF;
+
+    *has_operand = m->has_operand;
+    return m->opcode;
+}
+
+// Hash FNV-1a do nome de um símbolo
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Retorna a posição da tabela de símbolos onde o nome está (ou onde deve ser inserido)
+static int find_symbol_slot(const Assembler *a, const char *name) {
+    int mask = a->symbol_capacity - 1;
+    int slot = hash_name(name) & mask;
+
+    while (a->symbol_table[slot] != 0 && strcmp(a->variables[a->symbol_table[slot] - 1].name, name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Dobra a tabela de símbolos e reinsere os nomes (chamada quando passa da metade da ocupação)
+static void grow_symbol_table(Assembler *a) {
+    int *old = a->symbol_table;
+    int old_capacity = a->symbol_capacity;
+
+    a->symbol_capacity = a->symbol_capacity ? a->symbol_capacity * 2 : 64;
+    a->symbol_table = assemble_alloc(a, NULL, a->symbol_capacity, sizeof(int));
+    memset(a->symbol_table, 0, a->symbol_capacity * sizeof(int));
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i] != 0) a->symbol_table[find_symbol_slot(a, a->variables[old[i] - 1].name)] = old[i];
+    }
+    free(old);
+}
+
+// Função para fornecer o endereço da variavel
+static int get_variable_address(const Assembler *a, const char *name) {
+    if (a->symbol_capacity == 0) return -1;
+
+    int index = a->symbol_table[find_symbol_slot(a, name)];
+    return index ? a->variables[index - 1].address : -1;
+}
+
+// Função para adicionar a variavel na lista de variaveis
+// Um nome repetido ocupa outro endereço, mas as referências continuam indo para a primeira definição
+static void add_variable(Assembler *a, const char *name, int value, int initialized) {
+    if (a->variable_count == a->variable_capacity) {
+        a->variable_capacity = a->variable_capacity ? a->variable_capacity * 2 : 64;
+        a->variables = assemble_alloc(a, a->variables, a->variable_capacity, sizeof(Variable));
+    }
+    if ((a->variable_count + 1) * 2 > a->symbol_capacity) grow_symbol_table(a);
+
+    Variable *v = &a->variables[a->variable_count];
+    size_t name_size = strlen(name) + 1;
+    v->name = memcpy(assemble_alloc(a, NULL, name_size, 1), name, name_size);
+    v->address = -1;    // Definido no fim da leitura, depois do código
+    v->value = value;
+    v->initialized = initialized;
+    a->variable_count++;
+
+    int slot = find_symbol_slot(a, name);
+    if (a->symbol_table[slot] == 0) a->symbol_table[slot] = a->variable_count;
+}
+
+// Tamanho da memória no modo atual
+static int memory_size(const Assembler *a) {
+    return a->extended ? EXT_MEM_SIZE : MEM_SIZE;
+}
+
+// Registra um operando para ser preenchido no fim da leitura
+static void add_fixup(Assembler *a, int position, const char *name) {
+    size_t len = strlen(name) + 1;
+
+    if (a->fixup_count == a->fixup_capacity) {
+        a->fixup_capacity = a->fixup_capacity ? a->fixup_capacity * 2 : 256;
+        a->fixups = assemble_alloc(a, a->fixups, a->fixup_capacity, sizeof(Fixup));
+    }
+    while (a->fixup_names_len + len > a->fixup_names_capacity) {
+        a->fixup_names_capacity = a->fixup_names_capacity ? a->fixup_names_capacity * 2 : 4096;
+        a->fixup_names = assemble_alloc(a, a->fixup_names, a->fixup_names_capacity, 1);
+    }
+    a->fixups[a->fixup_count].position = position;
+    a->fixups[a->fixup_count].name = a->fixup_names_len;
+    a->fixup_count++;
+    memcpy(a->fixup_names + a->fixup_names_len, name, len);
+    a->fixup_names_len += len;
+}
+
+// Libera as tabelas da montagem
+static void assembler_free(Assembler *a) {
+    for (int i = 0; i < a->variable_count; i++) {
+        free(a->variables[i].name);
+    }
+    free(a->variables);
+    free(a->symbol_table);
+    free(a->fixups);
+    free(a->fixup_names);
+    neander_buffer_free(&a->line);
+}
+
+// Separa a linha em até max_tokens palavras, terminando cada uma com '\0' na própria linha
+static int tokenize(char *line, char **tokens, int max_tokens) {
+    int count = 0;
+    char *p = line;
+
+    while (count < max_tokens) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+        if (*p == '\0') break;
+        tokens[count++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+        if (*p != '\0') *p++ = '\0';
+    }
+    return count;
+}
+
+// Copia a próxima linha de source (a partir de *pos) para line, com o '\n' final, como o fgets faria,
+// mas sem limite de tamanho. Retorna 0 no fim do texto
+static int next_line(const char *source, size_t len, size_t *pos, NeanderBuffer *line) {
+    if (*pos >= len) return 0;
+
+    const char *start = source + *pos;
+    const char *newline = memchr(start, '\n', len - *pos);
+    size_t n = newline ? (size_t)(newline - start) + 1 : len - *pos;
+    line->len = 0;
+    neander_buffer_append(line, start, n);
+    *pos += n;
+    return 1;
+}
+
+// Processa o assembly em uma única passada: o código é gerado na hora e os operandos ficam registrados
+// como pendências, preenchidas no fim, quando o tamanho do código (e o endereço das variáveis) é conhecido
+static void parse_source(Assembler *a, const char *source, size_t len) {
+    char *tokens[3];
+    size_t pos = 0;
+    int parsing_code = 0;   // Verificar se esta na seção .DATA ou .CODE
+    int addr = 0;
+    int reserved = 0;       // Operandos que faltaram na linha continuam ocupando espaço antes das variáveis
+
+    while (next_line(source, len, &pos, &a->line)) {
+        if (a->line.failed) {
+            a->failed = 1;
+            assemble_error(a, "memoria insuficiente");
+        }
+        char *line = a->line.data;
+        if (line[0] == ';' || line[0] == '\n') continue;    // Se a linha for comentario, entao ignora
+
+        if (strstr(line, ".EXT")) {
+            if (addr > 0 && !a->extended) {
+                assemble_error(a, "a diretiva .EXT deve aparecer antes do codigo.");
+            }
+            a->extended = 1;
+            continue;
+        }
+        if (strstr(line, ".DATA")) {
+            parsing_code = 0;   // Se estiver na seção .DATA, então valor é 0
+            continue;
+        }
+        if (strstr(line, ".CODE")) {
+            parsing_code = 1;   // // Se estiver na seção .CODE, então valor é 1
+            continue;
+        }
+
+        int count = tokenize(line, tokens, 3);
+        if (!parsing_code) { // .DATA
+            // Verifica se a linha esta no formato: Nome DB Valor
+            if (count == 3 && strcmp(tokens[1], "DB") == 0) {
+                if (strcmp(tokens[2], "?") == 0) {  // Verifica se a variavel tem um valor ou não
+                    add_variable(a, tokens[0], 0, 0);
+                } else {
+                    add_variable(a, tokens[0], atoi(tokens[2]), 1);
+                }
+            }
+        } else if (count > 0) { // .CODE
+            int has_operand;
+            uint8_t opcode = get_opcode(tokens[0], &has_operand);   // Converte o mnemonico em opcode
+            int operand_size = a->extended ? 2 : 1;
+            if (opcode == 0xFF) continue;
+
+            if (addr + 1 + operand_size > EXT_MEM_SIZE) {
+                assemble_error(a, "o codigo nao cabe na memoria.");
+            }
+            a->memory[addr++] = opcode;     // Adiciona o opcode na memoria
+            if (has_operand && count >= 2) {
+                add_fixup(a, addr, tokens[1]);  // Operando preenchido no fim (variável ou número)
+                addr += operand_size;
+            } else if (has_operand) {
+                reserved += operand_size;
+            }
+        }
+    }
+
+    a->code_size = addr + reserved;
+    if (a->code_size + a->variable_count > memory_size(a)) {
+        assemble_error(a, "o programa ocupa %d bytes e a memoria tem %d%s.", a->code_size + a->variable_count,
+                       memory_size(a), a->extended ? "" : " (use --ext para o modo estendido)");
+    }
+
+    // Armazenar valores das variáveis na memória nos endereços corretos, logo depois do código
+    for (int i = 0; i < a->variable_count; i++) {
+        a->variables[i].address = a->code_size + i;
+        a->memory[a->variables[i].address] = a->variables[i].value;
+    }
+
+    // Preencher os operandos
+    for (int i = 0; i < a->fixup_count; i++) {
+        const char *name = a->fixup_names + a->fixups[i].name;
+        int operand = get_variable_address(a, name);
+        if (operand == -1) operand = atoi(name);
+        a->memory[a->fixups[i].position] = (uint8_t)operand;
+        if (a->extended) a->memory[a->fixups[i].position + 1] = (uint8_t)(operand >> 8);  // Byte alto do operando (little-endian)
+    }
+}
+
+// Escreve um inteiro little-endian de 16 ou 32 bits
+static void put_le(uint8_t *p, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+// Monta a imagem no formato compacto (denso ou esparso) em out e retorna o seu tamanho
+static size_t build_compact(const Assembler *a, uint8_t *out, int sparse) {
+    const uint8_t *image = a->memory;
+    uint8_t header[] = COMPACT_HEADER;
+    size_t size = COMPACT_HEADER_SIZE;
+    uint32_t count = 0;
+    int used = memory_size(a);
+
+    while (used > 0 && image[used - 1] == 0) used--;
+
+    memcpy(out, header, 4);
+    out[4] = COMPACT_VERSION;
+    out[5] = (sparse ? COMPACT_SPARSE : 0) | (a->extended ? COMPACT_EXTENDED : 0);
+    out[6] = out[7] = 0;
+
+    if (!sparse) {
+        memcpy(out + size, image, used);
+        size += used;
+        count = used;
+    } else {
+        // Cada trecho termina quando aparecem SPARSE_MIN_GAP zeros seguidos (ou com RUN_MAX bytes)
+        int i = 0;
+        while (i < used) {
+            if (image[i] == 0) {
+                i++;
+                continue;
+            }
+            int start = i, zeros = 0, end = i;
+            while (i < used && zeros < SPARSE_MIN_GAP && i - start < RUN_MAX) {
+                if (image[i] == 0) {
+                    zeros++;
+                } else {
+                    zeros = 0;
+                    end = i + 1;
+                }
+                i++;
+            }
+            put_le(out + size, start, 2);
+            put_le(out + size + 2, end - start, 2);
+            memcpy(out + size + 4, image + start, end - start);
+            size += 4 + (end - start);
+            count++;
+            i = end;
+        }
+    }
+    put_le(out + 8, count, 4);
+    return size;
+}
+
+// Acrescenta a imagem montada em image, no formato pedido
+static void write_image(const Assembler *a, ImageFormat format, NeanderBuffer *image) {
+    if (format == FORMAT_PADDED) {
+        uint8_t header[] = FILE_HEADER;
+        uint8_t padded[MEM_SIZE * 2] = {0};
+        for (int i = 0; i < MEM_SIZE; i++) {
+            padded[i * 2] = a->memory[i];   // Cada byte é seguido por um separador 00 no arquivo do neander
+        }
+        neander_buffer_append(image, header, HEADER_SIZE);
+        neander_buffer_append(image, padded, MEM_SIZE * 2);
+    } else {
+        // Pior caso do esparso: um trecho de 4 bytes de prefixo a cada byte não nulo
+        size_t worst = COMPACT_HEADER_SIZE + (size_t)memory_size(a) * 5;
+        if (neander_buffer_reserve(image, worst) != 0) return;
+        image->len += build_compact(a, (uint8_t *)image->data + image->len, format == FORMAT_SPARSE);
+    }
+}
+
+// Monta o assembly em source e acrescenta a imagem em image.
+// Retorna NEANDER_OK, NEANDER_ERROR com a mensagem em error, ou NEANDER_NO_MEMORY (image fica incompleta)
+NeanderResult neander_assemble(const char *source, size_t len, ImageFormat format, int extended, NeanderBuffer *image,
+                               char *error, size_t error_size) {
+    // A memória de 64 KiB não vai para a pilha (a biblioteca pode rodar em threads com pilha pequena)
+    int failed = 0;
+    Assembler *a = neander_alloc(NULL, 1, sizeof(Assembler), &failed);
+    if (!a) {
+        snprintf(error, error_size, "memoria insuficiente");
+        return NEANDER_NO_MEMORY;
+    }
+    memset(a, 0, sizeof(Assembler));
+    a->extended = extended;
+    a->error = error;
+    a->error_size = error_size;
+
+    if (setjmp(a->fail)) {
+        NeanderResult result = a->failed ? NEANDER_NO_MEMORY : NEANDER_ERROR;
+        assembler_free(a);
+        free(a);
+        return result;
+    }
+
+    parse_source(a, source, len);
+    // O formato original só comporta 256 bytes: o modo estendido usa o esparso
+    write_image(a, a->extended && format == FORMAT_PADDED ? FORMAT_SPARSE : format, image);
+    if (image->failed) {
+        a->failed = 1;
+        assemble_error(a, "memoria insuficiente");
+    }
+
+    assembler_free(a);
+    free(a);
+    return NEANDER_OK;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <errno.h>
+
+#include "neander.h"
+
+// Buffers em memória usados entre as etapas do pipeline (programa, assembly e imagem) e arenas
+
+#define ARENA_BLOCK_SIZE 16384
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t size;
+    max_align_t data[];
+};
+
+// Realoca p (NULL: nova alocação) para count elementos de size bytes. Sem memória, ou se o tamanho
+// não cabe em size_t, devolve NULL e marca *failed; p continua válido e nada encerra o processo
+void *neander_alloc(void *p, size_t count, size_t size, int *failed) {
+    if (size && count > SIZE_MAX / size) {
+        *failed = 1;
+        return NULL;
+    }
+    size_t bytes = count * size;
+    void *q = realloc(p, bytes ? bytes : 1);
+    if (!q) *failed = 1;
+    return q;
+}
+
+// Reserva size bytes (zerados) na arena; não há liberação individual. Retorna NULL sem memória
+void *neander_arena_alloc(Arena *arena, size_t size) {
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->used + size > block->size) {
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = neander_alloc(NULL, 1, sizeof(ArenaBlock) + capacity, &arena->failed);
+        if (!block) return NULL;
+        block->next = arena->head;
+        block->used = 0;
+        block->size = capacity;
+        arena->head = block;
+    }
+
+    void *p = (char *)block->data + block->used;
+    block->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+char *neander_arena_strdup(Arena *arena, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *p = neander_arena_alloc(arena, len);
+    return p ? memcpy(p, s, len) : NULL;
+}
+
+// Libera todos os blocos da arena de uma vez
+void neander_arena_free(Arena *arena) {
+    while (arena->head) {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+
+// Garante espaço para mais extra bytes no buffer (mais o '\0' final, para uso como texto).
+// Retorna 0, ou -1 sem memória (o buffer fica marcado e todas as reservas seguintes falham)
+int neander_buffer_reserve(NeanderBuffer *b, size_t extra) {
+    if (b->failed) return -1;
+    if (b->len + extra + 1 <= b->capacity) return 0;
+
+    size_t capacity = b->capacity ? b->capacity : 1024;
+    while (b->len + extra + 1 > capacity && capacity <= SIZE_MAX / 2) capacity *= 2;
+    char *data = b->len + extra + 1 > capacity ? NULL : neander_alloc(b->data, capacity, 1, &b->failed);
+    if (!data) {
+        b->failed = 1;
+        return -1;
+    }
+    b->data = data;
+    b->capacity = capacity;
+    return 0;
+}
+
+// Acrescenta len bytes ao buffer
+void neander_buffer_append(NeanderBuffer *b, const void *data, size_t len) {
+    if (neander_buffer_reserve(b, len) != 0) return;
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+}
+
+// Acrescenta texto formatado ao buffer
+void neander_buffer_printf(NeanderBuffer *b, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len <= 0 || neander_buffer_reserve(b, len) != 0) return;
+
+    va_start(args, format);
+    vsnprintf(b->data + b->len, len + 1, format, args);
+    va_end(args);
+    b->len += len;
+}
+
+// Libera o conteúdo do buffer, que pode ser reutilizado depois
+void neander_buffer_free(NeanderBuffer *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->capacity = 0;
+    b->failed = 0;
+}
+
+// Lê o arquivo inteiro para o buffer ("-" lê da entrada padrão). Retorna 0, ou -1 com errno definido
+// (ENOMEM sem memória)
+int neander_read_file(const char *filename, NeanderBuffer *out) {
+    FILE *file = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "rb");
+    char chunk[8192];
+    size_t n;
+
+    if (!file) return -1;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        neander_buffer_append(out, chunk, n);
+    }
+    if (file != stdin) fclose(file);
+    if (neander_buffer_reserve(out, 0) != 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    out->data[out->len] = '\0';
+    return 0;
+}
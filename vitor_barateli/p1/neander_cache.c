@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "neander.h"
+
+// Cache dos resultados do compilador e do montador, endereçado pelo conteúdo: a chave é formada pela
+// versão da ferramenta, pelas opções e pela entrada, e cada resultado fica em <dir>/<hash da chave>.<ext>.
+// O arquivo guarda a chave inteira antes do resultado, e um acerto só vale se ela for igual à procurada
+// (duas chaves com o mesmo hash nunca trocam de resultado). A data de modificação de uma entrada é o
+// último uso (LRU); acertos e faltas ficam em <dir>/stats
+
+#define CACHE_STATS_FILE "stats"
+#define CACHE_MAX_PATH 4096
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t entries;
+    uint64_t bytes;
+} CacheStats;
+#define CACHE_HASH_INIT 0xCBF29CE484222325ULL
+
+// Hash FNV-1a (64 bits) da chave, usado só como nome do arquivo
+static uint64_t cache_hash(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint64_t hash = CACHE_HASH_INIT;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Acrescenta um campo à chave (com o tamanho antes, para que campos vizinhos não se confundam)
+void neander_cache_key_add(NeanderBuffer *key, const void *data, size_t len) {
+    uint64_t size = len;
+    neander_buffer_append(key, &size, sizeof(size));
+    neander_buffer_append(key, data, len);
+}
+
+// Acrescenta à chave a versão da ferramenta: tamanho, data de modificação e inode do próprio executável
+// (recompilar a ferramenta invalida o cache, sem ler o executável inteiro a cada execução)
+void neander_cache_key_version(NeanderBuffer *key, const char *argv0) {
+    struct stat st;
+    uint64_t fields[4] = {0};
+    if (stat("/proc/self/exe", &st) == 0 || stat(argv0, &st) == 0) {
+        fields[0] = st.st_size;
+        fields[1] = st.st_ino;
+        fields[2] = st.st_mtim.tv_sec;
+        fields[3] = st.st_mtim.tv_nsec;
+    }
+    neander_cache_key_add(key, fields, sizeof(fields));
+}
+
+static void cache_path(const NeanderCache *cache, const NeanderBuffer *key, const char *ext, char *path, size_t size) {
+    snprintf(path, size, "%s/%016llx.%s", cache->dir, (unsigned long long)cache_hash(key->data, key->len), ext);
+}
+
+// Soma 1 ao contador de acertos ou de faltas (com o arquivo travado, para execuções em paralelo)
+static void cache_count(const NeanderCache *cache, int hit) {
+    char path[CACHE_MAX_PATH], text[64] = {0};
+    unsigned long long hits = 0, misses = 0;
+
+    snprintf(path, sizeof(path), "%s/%s", cache->dir, CACHE_STATS_FILE);
+    mkdir(cache->dir, 0755);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return;
+    flock(fd, LOCK_EX);
+    if (read(fd, text, sizeof(text) - 1) > 0) sscanf(text, "acertos %llu faltas %llu", &hits, &misses);
+    if (hit) hits++; else misses++;
+    int len = snprintf(text, sizeof(text), "acertos %llu faltas %llu\n", hits, misses);
+    if (pwrite(fd, text, len, 0) == len) ftruncate(fd, len);
+    close(fd);
+}
+
+// Procura o resultado da chave e acrescenta em out. Retorna 0 (acerto), ou -1 (falta, ou chave
+// incompleta por falta de memória)
+int neander_cache_get(const NeanderCache *cache, const NeanderBuffer *key, const char *ext, NeanderBuffer *out) {
+    char path[CACHE_MAX_PATH];
+    if (key->failed) return -1;
+    cache_path(cache, key, ext, path, sizeof(path));
+
+    // A entrada é [tamanho da chave][chave][resultado]; outra chave com o mesmo hash conta como falta
+    NeanderBuffer data = {0};
+    uint64_t size = 0;
+    int found = neander_read_file(path, &data) == 0 && data.len >= sizeof(size);
+    if (found) memcpy(&size, data.data, sizeof(size));
+    if (!found || size != key->len || data.len - sizeof(size) < size ||
+        memcmp(data.data + sizeof(size), key->data, key->len) != 0) {
+        neander_buffer_free(&data);
+        cache_count(cache, 0);
+        return -1;
+    }
+    size_t start = sizeof(size) + key->len;
+    neander_buffer_append(out, data.data + start, data.len - start);
+    neander_buffer_free(&data);
+    if (out->failed) return -1;
+    utimensat(AT_FDCWD, path, NULL, 0);     // Último uso, para o LRU
+    cache_count(cache, 1);
+    return 0;
+}
+
+// Entrada do cache durante a limpeza
+typedef struct {
+    char name[64];
+    off_t size;
+    struct timespec used;
+} CacheEntry;
+
+static int compare_used(const void *a, const void *b) {
+    const struct timespec *x = &((const CacheEntry *)a)->used, *y = &((const CacheEntry *)b)->used;
+    if (x->tv_sec != y->tv_sec) return x->tv_sec < y->tv_sec ? -1 : 1;
+    if (x->tv_nsec != y->tv_nsec) return x->tv_nsec < y->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+// Entradas do cache (os arquivos <chave>.<ext>), em *entries (liberar com free). Retorna a quantidade, ou -1
+// (diretório inexistente ou sem memória)
+static int cache_entries(const NeanderCache *cache, CacheEntry **entries) {
+    DIR *dir = opendir(cache->dir);
+    struct dirent *item;
+    int count = 0, capacity = 0;
+
+    *entries = NULL;
+    if (!dir) return -1;
+    while ((item = readdir(dir)) != NULL) {
+        char path[CACHE_MAX_PATH];
+        struct stat st;
+        const char *dot = strchr(item->d_name, '.');
+        if (!dot || dot - item->d_name != 16 || strlen(item->d_name) >= sizeof((*entries)->name)) continue;
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, item->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        if (count == capacity) {
+            int failed = 0;
+            capacity = capacity ? capacity * 2 : 64;
+            CacheEntry *grown = neander_alloc(*entries, capacity, sizeof(CacheEntry), &failed);
+            if (!grown) {
+                free(*entries);
+                *entries = NULL;
+                closedir(dir);
+                return -1;
+            }
+            *entries = grown;
+        }
+        CacheEntry *e = &(*entries)[count++];
+        snprintf(e->name, sizeof(e->name), "%s", item->d_name);
+        e->size = st.st_size;
+        e->used = st.st_mtim;
+    }
+    closedir(dir);
+    return count;
+}
+
+// Remove as entradas usadas há mais tempo até o diretório caber em cache->max_bytes
+static void cache_evict(const NeanderCache *cache) {
+    CacheEntry *entries;
+    int count = cache_entries(cache, &entries);
+    uint64_t total = 0;
+
+    for (int i = 0; i < count; i++) total += entries[i].size;
+    if (cache->max_bytes && total > cache->max_bytes) {
+        qsort(entries, count, sizeof(CacheEntry), compare_used);
+        for (int i = 0; i < count && total > cache->max_bytes; i++) {
+            char path[CACHE_MAX_PATH];
+            snprintf(path, sizeof(path), "%s/%s", cache->dir, entries[i].name);
+            if (unlink(path) == 0) total -= entries[i].size;
+        }
+    }
+    free(entries);
+}
+
+// Guarda o resultado da chave, precedido pela própria chave (escrito em um arquivo temporário e
+// renomeado, para que um leitor em paralelo nunca veja uma entrada pela metade) e aplica o limite de
+// tamanho. Retorna 0, ou -1
+int neander_cache_put(const NeanderCache *cache, const NeanderBuffer *key, const char *ext, const NeanderBuffer *data) {
+    char path[CACHE_MAX_PATH], temp[CACHE_MAX_PATH];
+    uint64_t size = key->len;
+
+    if (key->failed) return -1;
+    mkdir(cache->dir, 0755);
+    cache_path(cache, key, ext, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s/tmp.%ld.%s", cache->dir, (long)getpid(), ext);
+
+    FILE *file = fopen(temp, "wb");
+    if (!file) return -1;
+    int ok = fwrite(&size, sizeof(size), 1, file) == 1 && fwrite(key->data, 1, key->len, file) == key->len &&
+             fwrite(data->data, 1, data->len, file) == data->len;
+    if (fclose(file) != 0 || !ok || rename(temp, path) != 0) {
+        unlink(temp);
+        return -1;
+    }
+    cache_evict(cache);
+    return 0;
+}
+
+// Contadores e ocupação do cache. Retorna 0, ou -1 se o diretório não existe
+static int cache_stats(const NeanderCache *cache, CacheStats *stats) {
+    char path[CACHE_MAX_PATH], text[64] = {0};
+    unsigned long long hits = 0, misses = 0;
+    CacheEntry *entries;
+
+    memset(stats, 0, sizeof(CacheStats));
+    int count = cache_entries(cache, &entries);
+    if (count < 0) return -1;
+    stats->entries = count;
+    for (int i = 0; i < count; i++) stats->bytes += entries[i].size;
+    free(entries);
+
+    snprintf(path, sizeof(path), "%s/%s", cache->dir, CACHE_STATS_FILE);
+    FILE *file = fopen(path, "r");
+    if (file) {
+        if (fgets(text, sizeof(text), file)) sscanf(text, "acertos %llu faltas %llu", &hits, &misses);
+        fclose(file);
+    }
+    stats->hits = hits;
+    stats->misses = misses;
+    return 0;
+}
+
+// Mostra acertos, faltas, entradas e bytes do cache (--cache-stats). Retorna 0, ou -1 se não há cache
+int neander_cache_print_stats(const NeanderCache *cache) {
+    CacheStats stats;
+    if (!cache->dir || cache_stats(cache, &stats) != 0) {
+        fprintf(stderr, "Erro: cache nao encontrado (use --cache <diretorio> ou NEANDER_CACHE)\n");
+        return -1;
+    }
+    printf("Cache %s: %llu acertos, %llu faltas, %llu entradas, %llu bytes\n", cache->dir,
+           (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+           (unsigned long long)stats.entries, (unsigned long long)stats.bytes);
+    return 0;
+}
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "neander.h"
+
+// Lista de instruções gerada pelo compilador (a representação intermediária) e otimizador peephole sobre ela.
+// Como os desvios apontam para rótulos, instruções podem ser removidas livremente:
+// os endereços só são calculados em neander_code_write. Cada passada percorre a lista uma vez (tempo linear)
+
+#define MAX_KNOWN 16    // Variáveis cujo valor o otimizador lembra que é igual ao AC
+#define MAX_HOPS 16     // Saltos seguidos ao encadear desvios (evita ciclos de JMP)
+
+const char *neander_op_names[] = {"NOP", "STA", "LDA", "ADD", "OR", "AND", "NOT", "JMP", "JN", "JZ", "HLT"};
+
+// Cria um rótulo ainda sem posição
+int neander_code_new_label(CodeList *code) {
+    return code->labels++;
+}
+
+// Acrescenta uma instrução ao fim da lista (operand pode ser NULL). Sem memória marca code->failed
+static void code_push(CodeList *code, Op op, int target, const char *operand) {
+    if (code->count == code->capacity) {
+        int capacity = code->capacity ? code->capacity * 2 : 64;
+        Instr *items = neander_alloc(code->items, capacity, sizeof(Instr), &code->failed);
+        if (!items) return;
+        code->items = items;
+        code->capacity = capacity;
+    }
+    Instr *instr = &code->items[code->count++];
+    instr->op = op;
+    instr->target = target;
+    snprintf(instr->operand, sizeof(instr->operand), "%s", operand ? operand : "");
+}
+
+void neander_code_append(CodeList *code, Op op, const char *operand) {
+    code_push(code, op, -1, operand);
+}
+
+void neander_code_jump(CodeList *code, Op op, int label) {
+    code_push(code, op, label, NULL);
+}
+
+// Define a posição do rótulo: a próxima instrução acrescentada
+void neander_code_place_label(CodeList *code, int label) {
+    code_push(code, OP_LABEL, label, NULL);
+}
+
+// Define o rótulo na posição atual e guarda o endereço dele na variável name (ver neander_code_export_labels).
+// Rótulos exportados nunca são removidos pelo otimizador
+void neander_code_export_label(CodeList *code, int label, const char *name) {
+    code_push(code, OP_LABEL, label, name);
+}
+
+// STA do AC no operando da instrução definida logo depois do rótulo (o OP_RET de uma sub-rotina)
+void neander_code_patch(CodeList *code, int label) {
+    code_push(code, OP_STA, label, NULL);
+}
+
+void neander_code_free(CodeList *code) {
+    free(code->items);
+    code->items = NULL;
+    code->count = code->capacity = code->labels = 0;
+}
+
+int neander_is_jump(Op op) {
+    return op == OP_JMP || op == OP_JN || op == OP_JZ;
+}
+
+// Instruções que leem a variável do operando
+int neander_reads_operand(Op op) {
+    return op == OP_LDA || op == OP_ADD || op == OP_OR || op == OP_AND;
+}
+
+// STA no operando de uma instrução do próprio código (endereço de retorno de sub-rotina)
+static int patches_code(const Instr *instr) {
+    return instr->op == OP_STA && instr->target >= 0;
+}
+
+// Instruções que só escrevem no AC (e nas flags)
+static int defines_ac(Op op) {
+    return op == OP_LDA || op == OP_ADD || op == OP_OR || op == OP_AND || op == OP_NOT;
+}
+
+// Tamanho da instrução montada pelo assembler (NOP, NOT e HLT ocupam 1 byte; os rótulos, nenhum)
+// No modo estendido o operando ocupa 2 bytes
+static int instr_size(Op op, int extended) {
+    if (op == OP_LABEL) return 0;
+    if (op == OP_RET) return extended ? 3 : 2;
+    if (op == OP_NOP || op == OP_NOT || op == OP_HLT) return 1;
+    return extended ? 3 : 2;
+}
+
+// Mantém só as instruções com keep[i] != 0. Retorna 1 se alguma foi removida
+int neander_code_filter(CodeList *code, const char *keep) {
+    int j = 0;
+    for (int i = 0; i < code->count; i++) {
+        if (keep[i]) code->items[j++] = code->items[i];
+    }
+    int changed = j != code->count;
+    code->count = j;
+    return changed;
+}
+
+// Posição da primeira instrução real depois de cada rótulo (code->count se não houver)
+static void find_labels(const CodeList *code, int *label_at) {
+    int pending = 0;
+    for (int i = 0; i < code->count; i++) {
+        if (code->items[i].op == OP_LABEL) {
+            label_at[code->items[i].target] = -1;
+            pending = 1;
+        } else if (pending) {
+            for (int k = i - 1; k >= 0 && code->items[k].op == OP_LABEL; k--) label_at[code->items[k].target] = i;
+            pending = 0;
+        }
+    }
+    for (int k = code->count - 1; pending && k >= 0 && code->items[k].op == OP_LABEL; k--) {
+        label_at[code->items[k].target] = code->count;
+    }
+}
+
+// Encadeamento de desvios: um desvio para JMP L (ou JZ para JZ L, JN para JN L) vai direto para L,
+// e um desvio para a instrução seguinte é removido. Também remove rótulos sem referência
+// (eles impediriam as otimizações dentro do bloco), menos os exportados
+static int thread_jumps(CodeList *code, int *label_at, int *refs, char *keep) {
+    int changed = 0;
+
+    find_labels(code, label_at);
+    for (int i = 0; i < code->count; i++) {
+        Instr *jump = &code->items[i];
+        keep[i] = 1;
+        if (!neander_is_jump(jump->op)) continue;
+
+        for (int hops = 0; hops < MAX_HOPS; hops++) {
+            int t = label_at[jump->target];
+            if (t == code->count) break;
+            const Instr *next = &code->items[t];
+            // O desvio não muda o AC, então N e Z continuam iguais no destino
+            if ((next->op == OP_JMP || next->op == jump->op) && next->target != jump->target) {
+                jump->target = next->target;
+                changed = 1;
+            } else {
+                break;
+            }
+        }
+
+        int j = i + 1;
+        while (j < code->count && code->items[j].op == OP_LABEL && code->items[j].target != jump->target) j++;
+        if (j < code->count && code->items[j].op == OP_LABEL) keep[i] = 0;
+    }
+
+    memset(refs, 0, code->labels * sizeof(int));
+    for (int i = 0; i < code->count; i++) {
+        const Instr *instr = &code->items[i];
+        if (keep[i] && (neander_is_jump(instr->op) || patches_code(instr))) refs[instr->target]++;
+    }
+    for (int i = 0; i < code->count; i++) {
+        const Instr *instr = &code->items[i];
+        if (instr->op == OP_LABEL && !instr->operand[0] && refs[instr->target] == 0) keep[i] = 0;
+    }
+    return neander_code_filter(code, keep) | changed;
+}
+
+// Remove o código depois de JMP, HLT ou retorno que nenhum rótulo alcança
+static int remove_unreachable(CodeList *code, char *keep) {
+    int dead = 0;
+    for (int i = 0; i < code->count; i++) {
+        Op op = code->items[i].op;
+        if (op == OP_LABEL) dead = 0;
+        keep[i] = !dead;
+        if (op == OP_JMP || op == OP_HLT || op == OP_RET) dead = 1;
+    }
+    return neander_code_filter(code, keep);
+}
+
+// Procura o nome na lista de variáveis iguais ao AC
+static int known_index(const char **known, int count, const char *name) {
+    for (int k = 0; k < count; k++) {
+        if (strcmp(known[k], name) == 0) return k;
+    }
+    return -1;
+}
+
+// Repasse de STA para LDA e eliminação de cargas e escritas redundantes: dentro de um bloco,
+// lembra quais variáveis têm o mesmo valor do AC. LDA de uma delas não muda nada, e STA também não
+static int forward_values(CodeList *code, char *keep) {
+    const char *known[MAX_KNOWN];    // Operandos da própria lista (só é compactada no fim da passada)
+    int count = 0;
+
+    for (int i = 0; i < code->count; i++) {
+        const Instr *instr = &code->items[i];
+        keep[i] = 1;
+        switch (instr->op) {
+            case OP_LABEL:
+                count = 0;      // Outros caminhos chegam aqui com outro AC
+                break;
+            case OP_LDA:
+            case OP_STA:
+                if (patches_code(instr)) break;     // Escreve no código, as variáveis não mudam
+                if (known_index(known, count, instr->operand) >= 0) {
+                    keep[i] = 0;
+                    break;
+                }
+                if (instr->op == OP_LDA) count = 0;
+                if (count < MAX_KNOWN) known[count++] = instr->operand;
+                break;
+            case OP_ADD:
+            case OP_OR:
+            case OP_AND:
+            case OP_NOT:
+            case OP_NOP:
+                count = 0;
+                break;
+            default:
+                break;      // JN/JZ não mudam AC nem memória; depois de JMP/HLT/retorno vem um rótulo
+        }
+    }
+    return neander_code_filter(code, keep);
+}
+
+// Remove valores do AC que são descartados pelo LDA seguinte sem serem usados
+static int remove_dead_loads(CodeList *code, char *keep) {
+    for (int i = 0; i < code->count; i++) {
+        keep[i] = 1;
+        if (!defines_ac(code->items[i].op)) continue;
+
+        int j = i + 1;
+        while (j < code->count && code->items[j].op == OP_LABEL) j++;
+        if (j < code->count && code->items[j].op == OP_LDA) keep[i] = 0;
+    }
+    return neander_code_filter(code, keep);
+}
+
+// Remove STA de uma variável que é sobrescrita adiante, no mesmo caminho, antes de ser lida.
+// Percorre o código de trás para frente lembrando as variáveis que serão sobrescritas sem leitura
+static int remove_dead_stores(CodeList *code, char *keep) {
+    const char *overwritten[MAX_KNOWN];
+    int count = 0;
+
+    for (int i = code->count - 1; i >= 0; i--) {
+        const Instr *instr = &code->items[i];
+        keep[i] = 1;
+        if (neander_is_jump(instr->op) || instr->op == OP_HLT || instr->op == OP_RET) {
+            count = 0;
+        } else if (patches_code(instr)) {
+            continue;
+        } else if (instr->op == OP_STA) {
+            if (known_index(overwritten, count, instr->operand) >= 0) {
+                keep[i] = 0;
+            } else if (count < MAX_KNOWN) {
+                overwritten[count++] = instr->operand;
+            }
+        } else if (neander_reads_operand(instr->op)) {
+            int k = known_index(overwritten, count, instr->operand);
+            if (k >= 0) overwritten[k] = overwritten[--count];
+        }
+    }
+    return neander_code_filter(code, keep);
+}
+
+// Otimizador peephole: aplica as passadas até nenhuma mudar o código.
+// Todas preservam o AC e a memória de dados em cada desvio e no HLT. Sem memória o código fica como
+// está e code->failed é marcado
+void neander_code_peephole(CodeList *code) {
+    int *label_at = neander_alloc(NULL, code->labels + 1, sizeof(int), &code->failed);
+    int *refs = neander_alloc(NULL, code->labels + 1, sizeof(int), &code->failed);
+    char *keep = neander_alloc(NULL, code->count + 1, 1, &code->failed);
+
+    int changed = !code->failed;
+    while (changed) {
+        changed = thread_jumps(code, label_at, refs, keep);
+        changed |= remove_unreachable(code, keep);
+        changed |= forward_values(code, keep);
+        changed |= remove_dead_loads(code, keep);
+        changed |= remove_dead_stores(code, keep);
+    }
+    free(label_at);
+    free(refs);
+    free(keep);
+}
+
+// Endereço de cada rótulo no código montado (extended: operandos de 2 bytes). Liberar com free.
+// Retorna NULL sem memória, marcando *failed
+static int *code_addresses(const CodeList *code, int extended, int *failed) {
+    int *address = neander_alloc(NULL, code->labels + 1, sizeof(int), failed);
+    int pc = 0;
+
+    if (!address) return NULL;
+    for (int i = 0; i < code->count; i++) {
+        if (code->items[i].op == OP_LABEL) address[code->items[i].target] = pc;
+        pc += instr_size(code->items[i].op, extended);
+    }
+    return address;
+}
+
+void neander_code_export_labels(const CodeList *code, int extended, DataList *data) {
+    int *address = code_addresses(code, extended, &data->failed);
+
+    if (!address) return;
+    for (int i = 0; i < code->count; i++) {
+        const Instr *instr = &code->items[i];
+        if (instr->op != OP_LABEL || !instr->operand[0]) continue;
+        for (int d = 0; d < data->count; d++) {
+            if (strcmp(data->items[d].name, instr->operand) == 0) {
+                snprintf(data->items[d].value, sizeof(data->items[d].value), "%d", address[instr->target]);
+            }
+        }
+    }
+    free(address);
+}
+
+// Escreve o código em assembly, trocando os rótulos pelos endereços (extended: operandos de 2 bytes).
+// O retorno de sub-rotina sai como JMP 0 e o STA que o escreve aponta para o byte do operando
+void neander_code_write(const CodeList *code, int extended, NeanderBuffer *out) {
+    int *address = code_addresses(code, extended, &out->failed);
+
+    if (!address) return;
+    for (int i = 0; i < code->count; i++) {
+        const Instr *instr = &code->items[i];
+        if (instr->op == OP_LABEL) continue;
+        if (instr->op == OP_RET) {
+            neander_buffer_printf(out, "JMP 0\n");
+        } else if (neander_is_jump(instr->op)) {
+            neander_buffer_printf(out, "%s %d\n", neander_op_names[instr->op], address[instr->target]);
+        } else if (patches_code(instr)) {
+            neander_buffer_printf(out, "%s %d\n", neander_op_names[instr->op], address[instr->target] + 1);
+        } else if (instr->operand[0]) {
+            neander_buffer_printf(out, "%s %s\n", neander_op_names[instr->op], instr->operand);
+        } else {
+            neander_buffer_printf(out, "%s\n", neander_op_names[instr->op]);
+        }
+    }
+    free(address);
+}
@@ -0,0 +1,1833 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <stdint.h>
+
+#include "neander.h"
+
+// Definições de tamanho máximo para tokens e linhas
+#define MAX_TOKEN_LEN 100
+#define MAX_LINE_LEN 256
+
+// Modelo de custo das sub-rotinas: bytes de código de cada forma (medidos no código gerado) e
+// instruções a mais executadas por chamada, que contam como bytes ao comparar
+#define MUL_INLINE_SIZE 47      // Multiplicação no lugar
+#define MUL_ROUTINE_SIZE 38     // Sub-rotina de multiplicação, uma vez por imagem
+#define DIV_INLINE_SIZE 100     // Divisão no lugar
+#define DIV_ROUTINE_SIZE 92     // Sub-rotina de divisão, uma vez por imagem
+#define CALL_SIZE 20            // Chamada: argumentos, endereço de retorno (com o byte de dados), desvio e resultado
+#define CALL_OVERHEAD 6         // Instruções executadas a mais por chamada
+
+#define VALUE_BUCKETS 1024      // Tabela de números de valor (eliminação de subexpressões comuns)
+
+// Enumeração para os tipos de tokens reconhecidos
+typedef enum
+{
+    TOKEN_PROGRAMA,
+    TOKEN_LABEL,
+    TOKEN_DOIS_PONTOS,
+    TOKEN_INICIO,
+    TOKEN_VARIAVEL,
+    TOKEN_IGUAL,
+    TOKEN_NUMERO,
+    TOKEN_OPERADOR,
+    TOKEN_RES,
+    TOKEN_FIM,
+    TOKEN_PARENTESE_ESQ,
+    TOKEN_PARENTESE_DIR,
+    TOKEN_NOVA_LINHA,
+    TOKEN_EOF,
+    TOKEN_ASPAS,
+    TOKEN_ERRO
+} TokenType;
+
+// Estrutura para representar um token com o seu tipo e valor
+typedef struct
+{
+    TokenType type;
+    char lexeme[MAX_TOKEN_LEN];
+} Token;
+
+// Nó da árvore sintática de uma expressão (alocado na arena da compilação). Depois do parser, as
+// expressões viram um grafo em que cada valor aparece uma vez só (value_number), e os campos
+// uses e home dizem quantas vezes o valor é usado e onde ele já está calculado
+typedef enum
+{
+    NODE_VAR,       // Variável (name)
+    NODE_CONST,     // Valor conhecido na compilação (value)
+    NODE_BINARY     // Operação op entre left e right
+} NodeKind;
+
+typedef struct Node
+{
+    NodeKind kind;
+    char op;                    // '+', '-', '*', '/' ou '%'
+    struct Node *left;
+    struct Node *right;
+    const char *name;           // Nome em maiúsculas
+    uint8_t value;
+    int id;                     // Ordem de criação no grafo (ordena operandos de + e *)
+    int uses;                   // Referências ao valor (operandos e definições)
+    int need;                   // Temporárias _T que o cálculo usa (número de Sethi-Ullman, ver temps_needed)
+    const char *home;           // Variável ou temporária que já guarda o valor, ou NULL
+    int mark;                   // Última visita (ver Compiler.visit)
+    struct Node *chain;         // Próximo nó no mesmo balde da tabela de valores
+} Node;
+
+// Variável definida por uma expressão ("x = a + b")
+typedef struct Definition
+{
+    const char *name;
+    Node *expr;                 // Árvore do parser
+    Node *value;                // Valor no grafo
+    struct Definition *next;
+} Definition;
+
+// Estado de uma compilação. Tudo que era global fica aqui, para que várias compilações
+// possam acontecer ao mesmo tempo no mesmo processo
+typedef struct
+{
+    const char *source;               // Programa de entrada
+    size_t len;
+    size_t pos;                       // Posição de leitura em source
+    NeanderBuffer *out;               // Assembly gerado
+    CompileOptions options;
+    Token current_token;
+    Arena arena;                      // Nós da árvore sintática e nomes
+    Definition *definitions;          // Variáveis definidas por expressão, na ordem do programa
+    Definition **last_definition;
+    Node *values[VALUE_BUCKETS];      // Nós do grafo de valores, por hash
+    int value_count;
+    int visit;                        // Contador das visitas ao grafo (Node.mark)
+    int shared_count;                 // Temporárias _C0.._Cn dos valores usados mais de uma vez
+    CodeList code;                    // Representação intermediária do .CODE, com desvios para rótulos
+    DataList data;                    // Declarações do .DATA
+    int temp_count;                   // Temporárias _T0.._Tn usadas pelo código
+    bool need_const[256];             // Constantes usadas pelo código (_ZERO, _UM, _K<valor>)
+    bool call_mul;                    // Multiplicações chamam a sub-rotina compartilhada (rótulos mul_*)
+    bool call_div;                    // Divisões e restos chamam a sub-rotina compartilhada (rótulos div_*)
+    int mul_entry, mul_ret;
+    int div_entry, div_ret;
+    int returns;                      // Pontos de retorno criados (_R0.._Rn)
+    jmp_buf fail;                     // Retorno para neander_compile em caso de erro
+    char *error;
+    size_t error_size;
+} Compiler;
+
+// Lê o próximo caractere do programa (EOF no fim)
+static int next_char(Compiler *c)
+{
+    if (c->pos >= c->len)
+        return EOF;
+    return (unsigned char)c->source[c->pos++];
+}
+
+// Devolve o último caractere lido
+static void unget_char(Compiler *c, int ch)
+{
+    if (ch != EOF)
+        c->pos--;
+}
+
+// Função para registrar a mensagem de erro e abandonar a compilação (volta para neander_compile)
+static void compile_error(Compiler *c, const char *msg)
+{
+    snprintf(c->error, c->error_size, "%s", msg);
+    longjmp(c->fail, 1);
+}
+
+// Reserva memória na arena do compilador; sem memória a compilação é abandonada
+// (neander_compile devolve NEANDER_NO_MEMORY ao ver a marca da arena)
+static void *compiler_alloc(Compiler *c, size_t size)
+{
+    void *p = neander_arena_alloc(&c->arena, size);
+    if (!p)
+        compile_error(c, "memoria insuficiente");
+    return p;
+}
+
+static char *compiler_strdup(Compiler *c, const char *s)
+{
+    char *p = neander_arena_strdup(&c->arena, s);
+    if (!p)
+        compile_error(c, "memoria insuficiente");
+    return p;
+}
+
+// Função para fazer análise léxica (tokenização)
+static Token lexer(Compiler *c)
+{
+    int current;
+    Token token;
+
+    while ((current = next_char(c)) != EOF)
+    {
+        // Ignora espaços em branco
+        if (isspace(current))
+        {
+            if (current == '\n')
+            {
+                token.type = TOKEN_NOVA_LINHA;
+                strcpy(token.lexeme, "\n");
+                return token;
+            }
+            continue;
+        }
+
+        // Reconhece aspas
+        if (current == '"')
+        {
+            token.type = TOKEN_ASPAS;
+            strcpy(token.lexeme, "\"");
+            return token;
+        }
+
+        // Reconhece palavras (identificadores e palavras-chave)
+        if (isalpha(current))
+        {
+            int i = 0;
+            token.lexeme[i++] = current;
+            while (isalnum(current = next_char(c)))
+            {
+                if (i < MAX_TOKEN_LEN - 1)
+                    token.lexeme[i++] = current;
+            }
+            unget_char(c, current);  // Devolve o último caractere não alfanumérico
+            token.lexeme[i] = '\0';
+
+            // Verifica se é uma palavra-chave ou um label
+            if (strcmp(token.lexeme, "PROGRAMA") == 0)
+                token.type = TOKEN_PROGRAMA;
+            else if (strcmp(token.lexeme, "INICIO") == 0)
+                token.type = TOKEN_INICIO;
+            else if (strcmp(token.lexeme, "RES") == 0)
+                token.type = TOKEN_RES;
+            else if (strcmp(token.lexeme, "FIM") == 0)
+                token.type = TOKEN_FIM;
+            else
+                token.type = TOKEN_LABEL;
+            return token;
+        }
+
+        // Reconhece números
+        if (isdigit(current))
+        {
+            int i = 0;
+            token.lexeme[i++] = current;
+            while (isdigit(current = next_char(c)))
+            {
+                if (i < MAX_TOKEN_LEN - 1)
+                    token.lexeme[i++] = current;
+            }
+            unget_char(c, current);
+            token.lexeme[i] = '\0';
+            token.type = TOKEN_NUMERO;
+            return token;
+        }
+
+        // Reconhece símbolos especiais e operadores
+        switch (current)
+        {
+        case '=':
+            token.type = TOKEN_IGUAL;
+            strcpy(token.lexeme, "=");
+            return token;
+        case ':':
+            token.type = TOKEN_DOIS_PONTOS;
+            strcpy(token.lexeme, ":");
+            return token;
+        case '+':
+        case '-':
+        case '*':
+        case '/':
+        case '%':
+            token.type = TOKEN_OPERADOR;
+            token.lexeme[0] = current;
+            token.lexeme[1] = '\0';
+            return token;
+        case '(':
+            token.type = TOKEN_PARENTESE_ESQ;
+            strcpy(token.lexeme, "(");
+            return token;
+        case ')':
+            token.type = TOKEN_PARENTESE_DIR;
+            strcpy(token.lexeme, ")");
+            return token;
+        default:
+        {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Token desconhecido '%c'.", current);
+            compile_error(c, msg);
+        }
+        }
+    }
+    token.type = TOKEN_EOF;
+    return token;
+}
+
+// Avança para o próximo token
+static void advance(Compiler *c)
+{
+    c->current_token = lexer(c);
+}
+
+// Verifica se o token atual é o esperado, senão emite erro
+static void expect(Compiler *c, TokenType type)
+{
+    if (c->current_token.type == type)
+    {
+        advance(c);
+    }
+    else
+    {
+        compile_error(c, "Erro de sintaxe.");
+    }
+}
+
+static Node *expr(Compiler *c);
+
+// Cria um nó de variável com o nome do token atual em maiúsculas
+static Node *new_var(Compiler *c, const char *lexeme)
+{
+    Node *node = compiler_alloc(c, sizeof(Node));
+    char *name = compiler_strdup(c, lexeme);
+
+    // Converte a variavel para maiúsculo para manter o mesmo padrão
+    for (int i = 0; name[i]; i++)
+    {
+        name[i] = toupper((unsigned char)name[i]);
+    }
+    node->kind = NODE_VAR;
+    node->name = name;
+    return node;
+}
+
+static Node *new_binary(Compiler *c, char op, Node *left, Node *right)
+{
+    Node *node = compiler_alloc(c, sizeof(Node));
+    node->kind = NODE_BINARY;
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+// Analisa um fator: uma variável ou uma expressão entre parênteses
+static Node *fator(Compiler *c)
+{
+    if (c->current_token.type == TOKEN_LABEL)
+    {
+        Node *node = new_var(c, c->current_token.lexeme);
+        advance(c);
+        return node;
+    }
+    else if (c->current_token.type == TOKEN_PARENTESE_ESQ)
+    {
+        advance(c);
+        Node *node = expr(c);
+        expect(c, TOKEN_PARENTESE_DIR);
+        return node;
+    }
+    compile_error(c, "Fator inválido.");
+    return NULL;
+}
+
+// Analisa um termo: multiplicações, divisões e restos (associativos à esquerda)
+static Node *termo(Compiler *c)
+{
+    Node *node = fator(c);
+
+    while (c->current_token.type == TOKEN_OPERADOR && strchr("*/%", c->current_token.lexeme[0]))
+    {
+        char op = c->current_token.lexeme[0];
+        advance(c);
+        node = new_binary(c, op, node, fator(c));
+    }
+    return node;
+}
+
+// Analisa uma expressão: soma e subtração (associativas à esquerda)
+static Node *expr(Compiler *c)
+{
+    Node *node = termo(c);
+
+    while (c->current_token.type == TOKEN_OPERADOR && (c->current_token.lexeme[0] == '+' || c->current_token.lexeme[0] == '-'))
+    {
+        char op = c->current_token.lexeme[0];
+        advance(c);
+        node = new_binary(c, op, node, termo(c));
+    }
+    return node;
+}
+
+// Verifica se duas expressões são iguais (mesma árvore)
+static bool same_expr(const Node *a, const Node *b)
+{
+    if (a->kind != b->kind)
+        return false;
+    if (a->kind == NODE_VAR)
+        return strcmp(a->name, b->name) == 0;
+    if (a->kind == NODE_CONST)
+        return a->value == b->value;
+    return a->op == b->op && same_expr(a->left, b->left) && same_expr(a->right, b->right);
+}
+
+// Nome da temporária de índice i (o '_' não aparece em nomes do programa, então não há conflito)
+static const char *temp_name(Compiler *c, int i, char *buf)
+{
+    snprintf(buf, MAX_TOKEN_LEN, "_T%d", i);
+    if (i >= c->temp_count)
+        c->temp_count = i + 1;
+    return buf;
+}
+
+// Nome da posição que guarda a constante value (declarada como auxiliar no fim da compilação)
+static const char *const_name(Compiler *c, uint8_t value, char *buf)
+{
+    c->need_const[value] = true;
+    if (value == 0)
+        return "_ZERO";
+    if (value == 1)
+        return "_UM";
+    snprintf(buf, MAX_TOKEN_LEN, "_K%d", value);
+    return buf;
+}
+
+static const char *const_one(Compiler *c)
+{
+    return const_name(c, 1, NULL);
+}
+
+static const char *const_zero(Compiler *c)
+{
+    return const_name(c, 0, NULL);
+}
+
+// Valor inicial de uma variável declarada com número ("a = 4"). Variáveis sem valor, não declaradas
+// ou declaradas mais de uma vez não são conhecidas
+static bool known_value(const Compiler *c, const char *name, uint8_t *value)
+{
+    int found = 0;
+    for (int i = 0; i < c->data.count; i++)
+    {
+        const DataDecl *decl = &c->data.items[i];
+        if (strcmp(decl->name, name) != 0)
+            continue;
+        if (found++ || strcmp(decl->value, "?") == 0)
+            return false;
+        *value = (uint8_t)atoi(decl->value);
+    }
+    return found == 1;
+}
+
+// Valor de um operando já dobrado: constante ou variável de valor conhecido
+static bool node_value(const Compiler *c, const Node *node, uint8_t *value)
+{
+    if (node->kind == NODE_CONST)
+    {
+        *value = node->value;
+        return true;
+    }
+    return node->kind == NODE_VAR && known_value(c, node->name, value);
+}
+
+// Calcula l op r como o código gerado calcularia (aritmética módulo 256; divisão inteira,
+// e divisor 0 dá quociente 255 e resto l, como a divisão restauradora)
+uint8_t neander_fold_binary(char op, uint8_t l, uint8_t r)
+{
+    switch (op)
+    {
+    case '+':
+        return l + r;
+    case '-':
+        return l - r;
+    case '*':
+        return l * r;
+    case '/':
+        return r ? l / r : 255;
+    default:
+        return r ? l % r : l;
+    }
+}
+
+// Nó do grafo de valores: devolve o nó já existente com os mesmos campos, ou cria um (se create)
+static Node *find_value(Compiler *c, NodeKind kind, char op, Node *left, Node *right, const char *name, uint8_t value,
+                 bool create)
+{
+    size_t h = (size_t)kind * 31 + (unsigned char)op;
+    h = h * 31 + (left ? (size_t)left->id : 0);
+    h = h * 31 + (right ? (size_t)right->id : 0);
+    h = h * 31 + value;
+    for (const char *p = name; p && *p; p++)
+        h = h * 31 + (unsigned char)*p;
+    h %= VALUE_BUCKETS;
+
+    for (Node *n = c->values[h]; n; n = n->chain)
+    {
+        if (n->kind == kind && n->op == op && n->left == left && n->right == right && n->value == value &&
+            (n->name == name || (n->name && name && strcmp(n->name, name) == 0)))
+            return n;
+    }
+    if (!create)
+        return NULL;
+    Node *n = compiler_alloc(c, sizeof(Node));
+    n->kind = kind;
+    n->op = op;
+    n->left = left;
+    n->right = right;
+    n->name = name;
+    n->value = value;
+    n->id = ++c->value_count;
+    n->chain = c->values[h];
+    c->values[h] = n;
+    return n;
+}
+
+static Node *intern(Compiler *c, NodeKind kind, char op, Node *left, Node *right, const char *name, uint8_t value)
+{
+    return find_value(c, kind, op, left, right, name, value, true);
+}
+
+// Numeração de valores: traduz a árvore do parser para o grafo, onde expressões iguais são o mesmo nó.
+// Variáveis definidas antes de upto são trocadas pelo valor da definição (então "y = x + c" reaproveita
+// o valor de x), e as demais são lidas da memória. Com a propagação de constantes ativa, operações
+// entre valores conhecidos viram NODE_CONST; variáveis sozinhas continuam como estão (LDA da própria
+// variável custa o mesmo). Os operandos de + e * ficam em uma ordem fixa, para a + b e b + a coincidirem
+static Node *value_number(Compiler *c, const Node *node, const Definition *upto)
+{
+    if (node->kind == NODE_VAR)
+    {
+        Node *value = NULL;
+        for (const Definition *d = c->definitions; d != upto; d = d->next)
+        {
+            if (strcmp(d->name, node->name) == 0)
+                value = d->value;
+        }
+        return value ? value : intern(c, NODE_VAR, 0, NULL, NULL, node->name, 0);
+    }
+
+    Node *left = value_number(c, node->left, upto);
+    Node *right = value_number(c, node->right, upto);
+    uint8_t l, r;
+
+    if (!c->options.no_fold && node_value(c, left, &l) && node_value(c, right, &r))
+        return intern(c, NODE_CONST, 0, NULL, NULL, NULL, neander_fold_binary(node->op, l, r));
+    if ((node->op == '+' || node->op == '*') && left->id > right->id)
+    {
+        Node *t = left;
+        left = right;
+        right = t;
+    }
+    return intern(c, NODE_BINARY, node->op, left, right, NULL, 0);
+}
+
+// Estimativa de Sethi-Ullman das temporárias _T que o cálculo de node usa até deixar o valor no AC.
+// Soma e subtração calculam o operando mais pesado primeiro, guardam em uma temporária e calculam o
+// outro no AC: com pesos iguais, a temporária guardada soma um. Multiplicação e divisão guardam o
+// resultado, os dois operandos e as auxiliares do laço em temporárias
+static int temps_needed(const Node *node)
+{
+    const Node *left = node->left, *right = node->right;
+    int heavy = left->need > right->need ? left->need : right->need;
+    int light = left->need > right->need ? right->need : left->need;
+    int both = heavy > light ? heavy : light + 1;
+
+    if (node->op == '+' || node->op == '-')
+        return left->kind != NODE_BINARY || right->kind != NODE_BINARY ? heavy : both;
+    return 1 + (both > 5 ? both : 5);
+}
+
+// Conta as referências a cada valor (os operandos de um nó só são contados na primeira) e calcula
+// quantas temporárias cada um usa
+static void count_uses(Node *node)
+{
+    if (node->uses++ > 0 || node->kind != NODE_BINARY)
+        return;
+    count_uses(node->left);
+    count_uses(node->right);
+    node->need = temps_needed(node);
+}
+
+// Verifica se o cálculo de node lê a variável name (direto ou por um valor já guardado nela)
+static bool reads_var(Compiler *c, Node *node, const char *name)
+{
+    if (node->mark == c->visit)
+        return false;
+    node->mark = c->visit;
+    if (node->home)
+        return strcmp(node->home, name) == 0;
+    if (node->kind == NODE_VAR)
+        return strcmp(node->name, name) == 0;
+    if (node->kind == NODE_CONST)
+        return false;
+    return reads_var(c, node->left, name) || reads_var(c, node->right, name);
+}
+
+static void lower(Compiler *c, Node *node, const char *dest, int next);
+static void lower_ac(Compiler *c, Node *node, int next);
+
+// Operando com valor conhecido na compilação (só com a propagação de constantes ativa)
+static bool constant_operand(const Compiler *c, const Node *node, uint8_t *value)
+{
+    return !c->options.no_fold && node_value(c, node, value);
+}
+
+// Instruções da cadeia de somas que multiplica por k (dobras e somas depois do bit mais alto)
+static int mul_chain_cost(uint8_t k)
+{
+    int cost = 0;
+    for (int bit = 6; bit >= 0; bit--)
+    {
+        if (k >> (bit + 1))
+            cost += 2 + (k >> bit & 1);
+    }
+    return cost;
+}
+
+// dest = k * x sem laço: do bit mais alto de k para o mais baixo, dobra o valor (STA dest; ADD dest)
+// e soma x nos bits ligados. Se for mais curto, multiplica por -k e nega no fim (NOT; ADD _UM)
+static void lower_mul_const(Compiler *c, uint8_t k, const char *x, const char *dest)
+{
+    CodeList *code = &c->code;
+    bool negate = k != 0 && mul_chain_cost((uint8_t)-k) + 2 < mul_chain_cost(k);
+    if (negate)
+        k = (uint8_t)-k;
+
+    if (k == 0)
+    {
+        neander_code_append(code, OP_LDA, const_zero(c));
+        neander_code_append(code, OP_STA, dest);
+        return;
+    }
+
+    neander_code_append(code, OP_LDA, x);
+    for (int bit = 6; bit >= 0; bit--)
+    {
+        if (!(k >> (bit + 1)))
+            continue;
+        neander_code_append(code, OP_STA, dest);
+        neander_code_append(code, OP_ADD, dest);
+        if (k >> bit & 1)
+            neander_code_append(code, OP_ADD, x);
+    }
+    if (negate)
+    {
+        neander_code_append(code, OP_NOT, NULL);
+        neander_code_append(code, OP_ADD, const_one(c));
+    }
+    neander_code_append(code, OP_STA, dest);
+}
+
+// dest = left * right por deslocamento e soma: a cada passo testa um bit do multiplicador com uma
+// máscara (AND), soma o multiplicando se o bit está ligado e dobra o multiplicando e a máscara.
+// Os bits testados são apagados do multiplicador, e o laço termina quando ele zera: no máximo 8 passos.
+// Operandos que já estão em temporárias (owned) são alterados no lugar; variáveis do programa são copiadas
+static void lower_mul(Compiler *c, const char *left, bool left_owned, const char *right, bool right_owned,
+               const char *dest, int next)
+{
+    CodeList *code = &c->code;
+    char t1[MAX_TOKEN_LEN], t2[MAX_TOKEN_LEN], t3[MAX_TOKEN_LEN];
+    const char *multiplicand = left_owned ? left : temp_name(c, next, t1);
+    const char *multiplier = right_owned ? right : temp_name(c, next + 1, t2);
+    const char *mask = temp_name(c, next + 2, t3);
+    int start = neander_code_new_label(code);
+    int skip = neander_code_new_label(code);
+    int fim = neander_code_new_label(code);
+
+    neander_code_append(code, OP_LDA, const_zero(c));
+    neander_code_append(code, OP_STA, dest);
+    if (!left_owned)
+    {
+        neander_code_append(code, OP_LDA, left);
+        neander_code_append(code, OP_STA, multiplicand);
+    }
+    if (!right_owned)
+    {
+        neander_code_append(code, OP_LDA, right);
+        neander_code_append(code, OP_STA, multiplier);
+    }
+    neander_code_append(code, OP_LDA, const_one(c));
+    neander_code_append(code, OP_STA, mask);
+    neander_code_place_label(code, start);
+    neander_code_append(code, OP_LDA, multiplier);
+    neander_code_jump(code, OP_JZ, fim);
+    neander_code_append(code, OP_AND, mask);
+    neander_code_jump(code, OP_JZ, skip);
+    // Bit ligado: o AC é a própria máscara, então NOT; AND apaga o bit do multiplicador
+    neander_code_append(code, OP_NOT, NULL);
+    neander_code_append(code, OP_AND, multiplier);
+    neander_code_append(code, OP_STA, multiplier);
+    neander_code_append(code, OP_LDA, dest);
+    neander_code_append(code, OP_ADD, multiplicand);
+    neander_code_append(code, OP_STA, dest);
+    neander_code_place_label(code, skip);
+    neander_code_append(code, OP_LDA, multiplicand);
+    neander_code_append(code, OP_ADD, multiplicand);
+    neander_code_append(code, OP_STA, multiplicand);
+    neander_code_append(code, OP_LDA, mask);
+    neander_code_append(code, OP_ADD, mask);
+    neander_code_append(code, OP_STA, mask);
+    neander_code_jump(code, OP_JMP, start);
+    neander_code_place_label(code, fim);
+}
+
+// Divisão com resto (restauradora, bit a bit): quotient = left / right e remainder = left % right.
+// Um dos dois é dest e o outro uma temporária; left e right não são alterados. Divisor 0 dá
+// quociente 255 e resto left, como no algoritmo restaurador
+//   - divisor < 128: 8 passos. O dividendo é copiado para quotient e deslocado para a esquerda a cada
+//     passo: o bit que sai (testado com JN) entra no resto, e o bit do quociente entra no lugar vago.
+//     O resto nunca passa de 254, então resto >= divisor é decidido pelo sinal de resto - divisor
+//   - divisor >= 128: o quociente é 0 ou 1, uma comparação só
+// Com o divisor conhecido (known_divisor >= 0) só o caso dele é gerado, e o divisor negado é uma constante
+static void lower_div(Compiler *c, const char *left, const char *right, int known_divisor,
+               const char *quotient, const char *remainder, int next)
+{
+    CodeList *code = &c->code;
+    char t1[MAX_TOKEN_LEN], t2[MAX_TOKEN_LEN];
+    const char *negated = known_divisor >= 0 ? const_name(c, (uint8_t)-known_divisor, t1) : temp_name(c, next, t1);
+    const char *mask = temp_name(c, next + 1, t2);
+    int step = neander_code_new_label(code);
+    int one = neander_code_new_label(code);
+    int merge = neander_code_new_label(code);
+    int subtract = neander_code_new_label(code);
+    int store = neander_code_new_label(code);
+    int keep = neander_code_new_label(code);
+    int count = neander_code_new_label(code);
+    int large = neander_code_new_label(code);
+    int compare = neander_code_new_label(code);
+    int zero = neander_code_new_label(code);
+    int set = neander_code_new_label(code);
+    int fim = neander_code_new_label(code);
+
+    if (known_divisor < 0)
+    {
+        neander_code_append(code, OP_LDA, right);
+        neander_code_append(code, OP_NOT, NULL);
+        neander_code_append(code, OP_ADD, const_one(c));
+        neander_code_append(code, OP_STA, negated);
+    }
+    neander_code_append(code, OP_LDA, left);
+    neander_code_append(code, OP_STA, quotient);
+    if (known_divisor < 0)
+    {
+        neander_code_append(code, OP_LDA, right);
+        neander_code_jump(code, OP_JN, large);
+    }
+
+    if (known_divisor < 128)
+    {
+        neander_code_append(code, OP_LDA, const_zero(c));
+        neander_code_append(code, OP_STA, remainder);
+        neander_code_append(code, OP_LDA, const_one(c));
+        neander_code_append(code, OP_STA, mask);
+        // resto = 2 * resto + bit mais alto do dividendo
+        neander_code_place_label(code, step);
+        neander_code_append(code, OP_LDA, quotient);
+        neander_code_jump(code, OP_JN, one);
+        neander_code_append(code, OP_LDA, remainder);
+        neander_code_append(code, OP_ADD, remainder);
+        neander_code_jump(code, OP_JMP, merge);
+        neander_code_place_label(code, one);
+        neander_code_append(code, OP_LDA, remainder);
+        neander_code_append(code, OP_ADD, remainder);
+        neander_code_append(code, OP_ADD, const_one(c));
+        neander_code_place_label(code, merge);
+        neander_code_append(code, OP_STA, remainder);
+        // resto >= 128 é maior que o divisor; senão os dois são positivos e o sinal da diferença decide
+        neander_code_jump(code, OP_JN, subtract);
+        neander_code_append(code, OP_ADD, negated);
+        neander_code_jump(code, OP_JN, keep);
+        neander_code_jump(code, OP_JMP, store);
+        neander_code_place_label(code, subtract);
+        neander_code_append(code, OP_ADD, negated);
+        neander_code_place_label(code, store);
+        neander_code_append(code, OP_STA, remainder);
+        neander_code_append(code, OP_LDA, quotient);
+        neander_code_append(code, OP_ADD, quotient);
+        neander_code_append(code, OP_ADD, const_one(c));
+        neander_code_jump(code, OP_JMP, count);
+        neander_code_place_label(code, keep);
+        neander_code_append(code, OP_LDA, quotient);
+        neander_code_append(code, OP_ADD, quotient);
+        neander_code_place_label(code, count);
+        neander_code_append(code, OP_STA, quotient);
+        neander_code_append(code, OP_LDA, mask);
+        neander_code_append(code, OP_ADD, mask);
+        neander_code_append(code, OP_STA, mask);
+        neander_code_jump(code, OP_JZ, fim);
+        neander_code_jump(code, OP_JMP, step);
+    }
+
+    // Divisor >= 128: dividendo < 128 é menor; senão os dois têm o bit alto e o sinal da diferença decide
+    if (known_divisor < 0 || known_divisor >= 128)
+    {
+        neander_code_place_label(code, large);
+        neander_code_append(code, OP_LDA, quotient);
+        neander_code_append(code, OP_STA, remainder);
+        neander_code_jump(code, OP_JN, compare);
+        neander_code_jump(code, OP_JMP, zero);
+        neander_code_place_label(code, compare);
+        neander_code_append(code, OP_ADD, negated);
+        neander_code_jump(code, OP_JN, zero);
+        neander_code_append(code, OP_STA, remainder);
+        neander_code_append(code, OP_LDA, const_one(c));
+        neander_code_jump(code, OP_JMP, set);
+        neander_code_place_label(code, zero);
+        neander_code_append(code, OP_LDA, const_zero(c));
+        neander_code_place_label(code, set);
+        neander_code_append(code, OP_STA, quotient);
+    }
+    neander_code_place_label(code, fim);
+}
+
+// Chamada de sub-rotina: grava os argumentos nos parâmetros, o endereço de retorno (variável _R<n>,
+// com o endereço do rótulo logo depois do desvio) no operando do OP_RET da sub-rotina e desvia para ela.
+// Na volta, copia result para dest
+static void lower_call(Compiler *c, int entry, int ret, const char *param1, const char *arg1, const char *param2,
+                const char *arg2, const char *result, const char *dest)
+{
+    CodeList *code = &c->code;
+    char name[MAX_TOKEN_LEN];
+    int back = neander_code_new_label(code);
+
+    snprintf(name, sizeof(name), "_R%d", c->returns++);
+    neander_data_append(&c->data, name, "0", false);
+    neander_code_append(code, OP_LDA, arg1);
+    neander_code_append(code, OP_STA, param1);
+    neander_code_append(code, OP_LDA, arg2);
+    neander_code_append(code, OP_STA, param2);
+    neander_code_append(code, OP_LDA, name);
+    neander_code_patch(code, ret);
+    neander_code_jump(code, OP_JMP, entry);
+    neander_code_export_label(code, back, name);
+    neander_code_append(code, OP_LDA, result);
+    neander_code_append(code, OP_STA, dest);
+}
+
+// Sub-rotinas compartilhadas, depois do HLT: multiplicação (_MA * _MB em _MR) e divisão
+// (_DQ / _DB, com o quociente em _DQ e o resto em _DR). As temporárias internas vêm depois
+// de todas as usadas pelo programa
+static void lower_routines(Compiler *c)
+{
+    CodeList *code = &c->code;
+
+    if (c->call_mul)
+    {
+        neander_code_place_label(code, c->mul_entry);
+        lower_mul(c, "_MA", true, "_MB", true, "_MR", c->temp_count);
+        neander_code_place_label(code, c->mul_ret);
+        neander_code_append(code, OP_RET, NULL);
+    }
+    if (c->call_div)
+    {
+        neander_code_place_label(code, c->div_entry);
+        lower_div(c, "_DQ", "_DB", -1, "_DQ", "_DR", c->temp_count);
+        neander_code_place_label(code, c->div_ret);
+        neander_code_append(code, OP_RET, NULL);
+    }
+}
+
+// Conta as multiplicações (sem operando constante) e as divisões do grafo, cada valor uma vez
+static void count_calls(const Compiler *c, Node *node, int *muls, int *divs)
+{
+    uint8_t k;
+
+    if (node->kind != NODE_BINARY || node->mark == c->visit)
+        return;
+    node->mark = c->visit;
+    count_calls(c, node->left, muls, divs);
+    count_calls(c, node->right, muls, divs);
+    if (node->op == '*' && !constant_operand(c, node->left, &k) && !constant_operand(c, node->right, &k))
+        (*muls)++;
+    else if (node->op == '/' || node->op == '%')
+        (*divs)++;
+}
+
+// Modelo de custo: a sub-rotina compensa quando o código dela mais as chamadas (e as instruções
+// a mais que elas executam) custam menos que repetir a operação em cada lugar. No modo estendido
+// a memória não falta e o endereço de retorno teria 2 bytes, então tudo fica no lugar
+static bool use_calls(const Compiler *c, int sites, int inline_size, int routine_size)
+{
+    if (sites == 0 || c->options.extended || c->options.calls == CALLS_NEVER)
+        return false;
+    if (c->options.calls == CALLS_ALWAYS)
+        return true;
+    return routine_size + sites * (CALL_SIZE + CALL_OVERHEAD) < sites * inline_size;
+}
+
+// Devolve onde está o valor de um operando: onde ele já foi guardado, a própria variável, ou a
+// temporária slot, onde o código do operando deixa o resultado (usando temporárias a partir de slot + 1).
+// Valores usados mais de uma vez são calculados em uma temporária _C<n> só deles e reaproveitados
+static const char *lower_operand(Compiler *c, Node *node, int slot, char *buf)
+{
+    if (node->home)
+        return node->home;
+    if (node->kind == NODE_VAR)
+        return node->name;
+    if (node->kind == NODE_CONST)
+        return const_name(c, node->value, buf);
+    if (node->uses > 1)
+    {
+        snprintf(buf, MAX_TOKEN_LEN, "_C%d", c->shared_count++);
+        const char *name = compiler_strdup(c, buf);
+        lower(c, node, name, slot);
+        node->home = name;
+        return name;
+    }
+    // Soma e subtração só escrevem o destino no fim: a temporária do resultado também serve ao cálculo
+    temp_name(c, slot, buf);
+    lower(c, node, buf, node->op == '+' || node->op == '-' ? slot : slot + 1);
+    return buf;
+}
+
+// Operando que não precisa de código para ser lido
+static bool ready(const Node *node)
+{
+    return node->home || node->kind != NODE_BINARY;
+}
+
+static bool pattern_append(char *pattern, size_t *len, const char *text)
+{
+    size_t n = strlen(text);
+    if (*len + n >= SUPEROPT_PATTERN_LEN)
+        return false;
+    memcpy(pattern + *len, text, n + 1);
+    *len += n;
+    return true;
+}
+
+// Monta o padrão de node para o banco do superotimizador (ver SuperoptDb): valores conhecidos entram
+// em decimal, e valores que não precisam de código são as folhas x, y e z, na ordem em que aparecem.
+// Abaixo da raiz só entram valores calculados uma vez; o valor conhecido de + e * fica à direita.
+// Retorna false se node não cabe em um padrão
+static bool superopt_pattern(Compiler *c, Node *node, bool top, char *pattern, size_t *len, Node **leaves, int *leaf_count)
+{
+    char text[MAX_TOKEN_LEN];
+    uint8_t k;
+
+    if (!top && constant_operand(c, node, &k))
+    {
+        snprintf(text, sizeof(text), "%d", k);
+        return pattern_append(pattern, len, text);
+    }
+    if (!top && ready(node))
+    {
+        int i = 0;
+        while (i < *leaf_count && leaves[i] != node)
+            i++;
+        if (i == 3)
+            return false;
+        if (i == *leaf_count)
+            leaves[(*leaf_count)++] = node;
+        snprintf(text, sizeof(text), "%c", 'x' + i);
+        return pattern_append(pattern, len, text);
+    }
+    if (node->kind != NODE_BINARY || (!top && node->uses > 1))
+        return false;
+
+    Node *left = node->left, *right = node->right;
+    if ((node->op == '+' || node->op == '*') && constant_operand(c, left, &k) && !constant_operand(c, right, &k))
+    {
+        left = node->right;
+        right = node->left;
+    }
+    snprintf(text, sizeof(text), "%c", node->op);
+    return pattern_append(pattern, len, "(") && superopt_pattern(c, left, false, pattern, len, leaves, leaf_count) &&
+           pattern_append(pattern, len, text) && superopt_pattern(c, right, false, pattern, len, leaves, leaf_count) &&
+           pattern_append(pattern, len, ")");
+}
+
+// Gera a sequência do banco do superotimizador para node, com o resultado no AC (a temporária da
+// sequência é _T<next>). Retorna false se o banco não tem o padrão de node
+static bool lower_superopt(Compiler *c, Node *node, int next)
+{
+    char pattern[SUPEROPT_PATTERN_LEN];
+    size_t len = 0;
+    Node *leaves[3];
+    int leaf_count = 0;
+
+    if (!c->options.superopt || !superopt_pattern(c, node, true, pattern, &len, leaves, &leaf_count))
+        return false;
+    const SuperoptEntry *entry = neander_superopt_find(c->options.superopt, pattern);
+    if (!entry)
+        return false;
+    for (int i = 0; i < entry->length; i++)
+    {
+        char operand = entry->code[i].operand;
+        if (operand >= 'x' && operand <= 'z' && operand - 'x' >= leaf_count)
+            return false;
+    }
+
+    for (int i = 0; i < entry->length; i++)
+    {
+        const SuperoptInstr *instr = &entry->code[i];
+        char buf[MAX_TOKEN_LEN];
+        const char *operand = NULL;
+        if (instr->operand == 't')
+            operand = temp_name(c, next, buf);
+        else if (instr->operand == '#')
+            operand = const_name(c, instr->value, buf);
+        else if (instr->operand)
+            operand = lower_operand(c, leaves[instr->operand - 'x'], next, buf);
+        neander_code_append(&c->code, instr->op, operand);
+    }
+    return true;
+}
+
+// Soma ou subtração com o resultado no AC. Um dos operandos termina no AC e o outro é lido da memória:
+// se só um precisa ser calculado, é ele que vai para o AC; se os dois precisam, o mais pesado é
+// calculado antes para uma temporária e o mais leve depois, no AC (ordem de Sethi-Ullman).
+// A subtração tem uma forma para cada lado: left + (~right + 1) com right no AC, ~(~left + right)
+// com left no AC, e com um operando constante vira uma soma
+static void lower_add_sub(Compiler *c, Node *node, int next)
+{
+    CodeList *code = &c->code;
+    Node *left = node->left, *right = node->right;
+    char buf[MAX_TOKEN_LEN];
+    uint8_t k;
+
+    if (node->op == '-' && constant_operand(c, right, &k))
+    {
+        // left - k = left + (-k)
+        lower_ac(c, left, next);
+        if ((uint8_t)-k)
+            neander_code_append(code, OP_ADD, const_name(c, (uint8_t)-k, buf));
+        return;
+    }
+    if (node->op == '-' && constant_operand(c, left, &k))
+    {
+        // k - right = ~right + (k + 1)
+        lower_ac(c, right, next);
+        neander_code_append(code, OP_NOT, NULL);
+        if ((uint8_t)(k + 1))
+            neander_code_append(code, OP_ADD, const_name(c, (uint8_t)(k + 1), buf));
+        return;
+    }
+
+    bool left_in_ac;
+    if (ready(left) != ready(right))
+        left_in_ac = ready(right);
+    else
+        left_in_ac = !ready(left) && left->need < right->need;
+    Node *in_ac = left_in_ac ? left : right;
+    const char *operand = lower_operand(c, left_in_ac ? right : left, next, buf);
+    lower_ac(c, in_ac, operand == buf ? next + 1 : next);
+
+    if (node->op == '+')
+    {
+        neander_code_append(code, OP_ADD, operand);
+    }
+    else if (left_in_ac)
+    {
+        neander_code_append(code, OP_NOT, NULL);
+        neander_code_append(code, OP_ADD, operand);
+        neander_code_append(code, OP_NOT, NULL);
+    }
+    else
+    {
+        neander_code_append(code, OP_NOT, NULL);
+        neander_code_append(code, OP_ADD, const_one(c));
+        neander_code_append(code, OP_ADD, operand);
+    }
+}
+
+// Deixa o valor de node no AC, usando as temporárias _T<next> em diante. Só somas, subtrações e padrões
+// do banco do superotimizador são calculados no próprio AC; os demais valores são lidos de onde
+// lower_operand os deixa
+static void lower_ac(Compiler *c, Node *node, int next)
+{
+    if (!ready(node) && node->uses <= 1 && lower_superopt(c, node, next))
+        return;
+    if (!ready(node) && node->uses <= 1 && (node->op == '+' || node->op == '-'))
+    {
+        lower_add_sub(c, node, next);
+        return;
+    }
+    char buf[MAX_TOKEN_LEN];
+    neander_code_append(&c->code, OP_LDA, lower_operand(c, node, next, buf));
+}
+
+// Gera o código que deixa o valor de node em dest. As temporárias usadas são _T<next> em diante,
+// e dest nunca é uma delas, então os operandos continuam válidos enquanto dest é escrito
+static void lower(Compiler *c, Node *node, const char *dest, int next)
+{
+    CodeList *code = &c->code;
+
+    if (node->kind != NODE_BINARY || node->home)
+    {
+        char buf[MAX_TOKEN_LEN];
+        neander_code_append(code, OP_LDA, lower_operand(c, node, 0, buf));
+        neander_code_append(code, OP_STA, dest);
+        return;
+    }
+
+    if (lower_superopt(c, node, next))
+    {
+        neander_code_append(code, OP_STA, dest);
+        return;
+    }
+    if (node->op == '+' || node->op == '-')
+    {
+        lower_add_sub(c, node, next);
+        neander_code_append(code, OP_STA, dest);
+        return;
+    }
+
+    // Os dois operandos ficam em temporárias: o que usa mais temporárias é calculado primeiro
+    char left_buf[MAX_TOKEN_LEN], right_buf[MAX_TOKEN_LEN];
+    const char *left, *right;
+    if (node->right->need > node->left->need)
+    {
+        right = lower_operand(c, node->right, next, right_buf);
+        left = lower_operand(c, node->left, next + 1, left_buf);
+    }
+    else
+    {
+        left = lower_operand(c, node->left, next, left_buf);
+        right = lower_operand(c, node->right, next + 1, right_buf);
+    }
+
+    switch (node->op)
+    {
+    case '*':
+    {
+        uint8_t k;
+        if (constant_operand(c, node->left, &k))
+            lower_mul_const(c, k, right, dest);
+        else if (constant_operand(c, node->right, &k))
+            lower_mul_const(c, k, left, dest);
+        else if (c->call_mul)
+            lower_call(c, c->mul_entry, c->mul_ret, "_MA", left, "_MB", right, "_MR", dest);
+        else
+            lower_mul(c, left, left == left_buf, right, right == right_buf, dest, next + 2);
+        break;
+    }
+    case '/':
+    case '%':
+    {
+        if (c->call_div)
+        {
+            lower_call(c, c->div_entry, c->div_ret, "_DQ", left, "_DB", right, node->op == '/' ? "_DQ" : "_DR", dest);
+            break;
+        }
+        char other[MAX_TOKEN_LEN];
+        const char *spare = temp_name(c, next + 2, other);
+        uint8_t k;
+        int known_divisor = constant_operand(c, node->right, &k) ? k : -1;
+        if (node->op == '/')
+            lower_div(c, left, right, known_divisor, dest, spare, next + 3);
+        else
+            lower_div(c, left, right, known_divisor, spare, dest, next + 3);
+        break;
+    }
+    }
+}
+
+// Gera o código de uma definição: name recebe o valor de node. Se home, name passa a ser
+// o lugar de onde os próximos usos do valor o leem
+static void lower_definition(Compiler *c, Node *node, const char *name, bool home)
+{
+    if (node->home && strcmp(node->home, name) == 0)
+        return;
+
+    // O valor que name tinha antes (lido por definições anteriores) pode ser usado de novo depois
+    // desta: guarda uma cópia antes de sobrescrever
+    Node *old = find_value(c, NODE_VAR, 0, NULL, NULL, name, 0, false);
+    if (old && old->uses > 1 && !old->home)
+    {
+        char buf[MAX_TOKEN_LEN];
+        snprintf(buf, sizeof(buf), "_C%d", c->shared_count++);
+        old->home = compiler_strdup(c, buf);
+        neander_code_append(&c->code, OP_LDA, name);
+        neander_code_append(&c->code, OP_STA, old->home);
+    }
+
+    c->visit++;
+    if (reads_var(c, node, name) || (!home && node->uses > 1))
+    {
+        // name também é operando, ou não pode guardar o valor para os outros usos:
+        // calcula no AC (ou em uma temporária) e copia no fim
+        lower_ac(c, node, 0);
+        neander_code_append(&c->code, OP_STA, name);
+    }
+    else
+    {
+        lower(c, node, name, 0);
+    }
+    if (home && node->kind != NODE_CONST && !node->home)
+        node->home = name;
+}
+
+// Variável declarada uma vez só (pode guardar um valor para os usos seguintes)
+static bool declared_once(const Compiler *c, const char *name)
+{
+    int count = 0;
+    for (int i = 0; i < c->data.count; i++)
+    {
+        if (strcmp(c->data.items[i].name, name) == 0)
+            count++;
+    }
+    return count == 1;
+}
+
+// Monta o grafo de valores das definições e de RES. O resultado de RES vai para a variável
+// definida pela mesma expressão (que já tem o valor; retorna NULL) ou, se nenhuma for igual, para a
+// última variável definida por expressão, ou para X sem definições (retorna o valor e o nome em target_name)
+static Node *number_program(Compiler *c, Node *res, const char **target_name)
+{
+    const Definition *target = NULL;
+    bool matched = false;
+
+    for (const Definition *d = c->definitions; d && !matched; d = d->next)
+    {
+        matched = same_expr(d->expr, res);
+        target = d;
+    }
+    *target_name = target ? target->name : "X";
+    if (!target)
+        neander_data_append(&c->data, *target_name, "?", false);
+
+    for (Definition *d = c->definitions; d; d = d->next)
+        d->value = value_number(c, d->expr, d);
+    Node *result = matched ? NULL : value_number(c, res, NULL);
+
+    for (Definition *d = c->definitions; d; d = d->next)
+        count_uses(d->value);
+    if (result)
+        count_uses(result);
+    return result;
+}
+
+// Gera o código das definições, na ordem do programa, e de RES (result, ver number_program).
+// Subexpressões repetidas, dentro de uma expressão ou entre definições, são calculadas uma vez só
+static void lower_program(Compiler *c, Node *result, const char *target_name)
+{
+    int muls = 0, divs = 0;
+    c->visit++;
+    for (Definition *d = c->definitions; d; d = d->next)
+        count_calls(c, d->value, &muls, &divs);
+    if (result)
+        count_calls(c, result, &muls, &divs);
+    c->call_mul = use_calls(c, muls, MUL_INLINE_SIZE, MUL_ROUTINE_SIZE);
+    c->call_div = use_calls(c, divs, DIV_INLINE_SIZE, DIV_ROUTINE_SIZE);
+    c->mul_entry = neander_code_new_label(&c->code);
+    c->mul_ret = neander_code_new_label(&c->code);
+    c->div_entry = neander_code_new_label(&c->code);
+    c->div_ret = neander_code_new_label(&c->code);
+
+    for (Definition *d = c->definitions; d; d = d->next)
+        lower_definition(c, d->value, d->name, declared_once(c, d->name));
+    if (result)
+        lower_definition(c, result, target_name, false);
+}
+
+// Alvos nativos (--target=c e --target=x86): o mesmo grafo de valores vira um programa que lê os
+// valores das variáveis (NOME=valor nos argumentos, ou uma linha por execução na entrada padrão),
+// calcula as definições na ordem do programa com a aritmética de 8 bits do código do Neander e
+// escreve o valor final de todas as variáveis em uma linha. Cada nó do grafo é calculado uma vez
+
+// A declaração i é a primeira com esse nome (a que dá o valor inicial da variável)
+static bool first_decl(const Compiler *c, int i)
+{
+    for (int j = 0; j < i; j++)
+    {
+        if (strcmp(c->data.items[j].name, c->data.items[i].name) == 0)
+            return false;
+    }
+    return true;
+}
+
+// Índice de name entre as variáveis do programa (cada nome uma vez, na ordem da primeira declaração);
+// com name NULL, o número de variáveis
+static int native_var(const Compiler *c, const char *name)
+{
+    int index = 0;
+    for (int i = 0; i < c->data.count; i++)
+    {
+        if (!first_decl(c, i))
+            continue;
+        if (name && strcmp(c->data.items[i].name, name) == 0)
+            return index;
+        index++;
+    }
+    return index;
+}
+
+// Escreve uma entrada de format por variável, separadas por vírgulas: com o nome, ou com o valor
+// inicial se values
+static void native_vars(Compiler *c, const char *format, bool values)
+{
+    for (int i = 0; i < c->data.count; i++)
+    {
+        const DataDecl *decl = &c->data.items[i];
+        if (!first_decl(c, i))
+            continue;
+        if (i > 0)
+            neander_buffer_printf(c->out, ", ");
+        if (values)
+            neander_buffer_printf(c->out, format, neander_initial_value(decl));
+        else
+            neander_buffer_printf(c->out, format, decl->name);
+    }
+}
+
+// Operando em C: variável (valor do início da execução, como nas folhas do grafo), constante ou
+// nó já calculado
+static void c_operand(const Compiler *c, const Node *node, char *buf, size_t size)
+{
+    if (node->kind == NODE_VAR)
+        snprintf(buf, size, "in[%d]", native_var(c, node->name));
+    else if (node->kind == NODE_CONST)
+        snprintf(buf, size, "%d", node->value);
+    else
+        snprintf(buf, size, "n%d", node->id);
+}
+
+// Calcula os operandos e depois o nó (uma vez por nó)
+static void c_node(Compiler *c, Node *node)
+{
+    if (node->kind != NODE_BINARY || node->mark == c->visit)
+        return;
+    node->mark = c->visit;
+    c_node(c, node->left);
+    c_node(c, node->right);
+
+    char l[MAX_TOKEN_LEN], r[MAX_TOKEN_LEN];
+    c_operand(c, node->left, l, sizeof(l));
+    c_operand(c, node->right, r, sizeof(r));
+    if (node->op == '/')
+        neander_buffer_printf(c->out, "    uint8_t n%d = div8(%s, %s);\n", node->id, l, r);
+    else if (node->op == '%')
+        neander_buffer_printf(c->out, "    uint8_t n%d = mod8(%s, %s);\n", node->id, l, r);
+    else
+        neander_buffer_printf(c->out, "    uint8_t n%d = (uint8_t)(%s %c %s);\n", node->id, l, node->op, r);
+}
+
+static void c_definition(Compiler *c, Node *node, const char *name)
+{
+    char value[MAX_TOKEN_LEN];
+    c_node(c, node);
+    c_operand(c, node, value, sizeof(value));
+    neander_buffer_printf(c->out, "    v[%d] = %s;\n", native_var(c, name), value);
+}
+
+static void write_c(Compiler *c, Node *result, const char *target_name)
+{
+    neander_buffer_printf(c->out,
+                  "// Gerado por compilador --target=c\n"
+                  "#include <stdio.h>\n"
+                  "#include <stdint.h>\n"
+                  "#include <stdlib.h>\n"
+                  "#include <string.h>\n"
+                  "\n"
+                  "#define VARS %d\n"
+                  "\n"
+                  "static const char *names[VARS] = {",
+                  native_var(c, NULL));
+    native_vars(c, "\"%s\"", false);
+    neander_buffer_printf(c->out, "};\nstatic const uint8_t initial[VARS] = {");
+    native_vars(c, "%d", true);
+    neander_buffer_printf(c->out, "};\n"
+                  "\n"
+                  "// Divisão e resto como no Neander: divisor 0 dá quociente 255 e resto igual ao dividendo\n"
+                  "static inline uint8_t div8(uint8_t l, uint8_t r) { return r ? l / r : 255; }\n"
+                  "static inline uint8_t mod8(uint8_t l, uint8_t r) { return r ? l %% r : l; }\n"
+                  "\n"
+                  "static void run(uint8_t *v)\n"
+                  "{\n"
+                  "    uint8_t in[VARS];\n"
+                  "    memcpy(in, v, VARS);\n");
+
+    c->visit++;
+    for (Definition *d = c->definitions; d; d = d->next)
+        c_definition(c, d->value, d->name);
+    if (result)
+        c_definition(c, result, target_name);
+
+    neander_buffer_printf(c->out,
+                  "}\n"
+                  "\n"
+                  "// Aplica um argumento NOME=valor\n"
+                  "static void assign(uint8_t *v, const char *arg)\n"
+                  "{\n"
+                  "    for (int i = 0; i < VARS; i++)\n"
+                  "    {\n"
+                  "        size_t len = strlen(names[i]);\n"
+                  "        if (strncmp(arg, names[i], len) == 0 && arg[len] == '=')\n"
+                  "        {\n"
+                  "            v[i] = (uint8_t)strtol(arg + len + 1, NULL, 10);\n"
+                  "            return;\n"
+                  "        }\n"
+                  "    }\n"
+                  "    fprintf(stderr, \"Erro: variavel desconhecida em '%%s'\\n\", arg);\n"
+                  "    exit(EXIT_FAILURE);\n"
+                  "}\n"
+                  "\n"
+                  "static void report(const uint8_t *v)\n"
+                  "{\n"
+                  "    for (int i = 0; i < VARS; i++)\n"
+                  "        printf(\"%%s=%%d%%c\", names[i], v[i], i == VARS - 1 ? '\\n' : ' ');\n"
+                  "}\n"
+                  "\n"
+                  "// Com argumentos: uma execução. Sem argumentos: uma execução por linha da entrada padrão,\n"
+                  "// sempre a partir dos valores iniciais\n"
+                  "int main(int argc, char *argv[])\n"
+                  "{\n"
+                  "    uint8_t v[VARS];\n"
+                  "    char line[1024];\n"
+                  "\n"
+                  "    if (argc > 1)\n"
+                  "    {\n"
+                  "        memcpy(v, initial, VARS);\n"
+                  "        for (int i = 1; i < argc; i++)\n"
+                  "            assign(v, argv[i]);\n"
+                  "        run(v);\n"
+                  "        report(v);\n"
+                  "        return EXIT_SUCCESS;\n"
+                  "    }\n"
+                  "    while (fgets(line, sizeof(line), stdin))\n"
+                  "    {\n"
+                  "        memcpy(v, initial, VARS);\n"
+                  "        for (char *arg = strtok(line, \" \\t\\r\\n\"); arg; arg = strtok(NULL, \" \\t\\r\\n\"))\n"
+                  "            assign(v, arg);\n"
+                  "        run(v);\n"
+                  "        report(v);\n"
+                  "    }\n"
+                  "    return EXIT_SUCCESS;\n"
+                  "}\n");
+}
+
+// Operando em x86-64: variável (cópia do início da execução em ins), constante ou nó já calculado (vals)
+static void x86_operand(const Compiler *c, const Node *node, char *buf, size_t size)
+{
+    if (node->kind == NODE_VAR)
+        snprintf(buf, size, "byte ptr [rip + ins + %d]", native_var(c, node->name));
+    else if (node->kind == NODE_CONST)
+        snprintf(buf, size, "%d", node->value);
+    else
+        snprintf(buf, size, "byte ptr [rip + vals + %d]", node->id);
+}
+
+// Carrega o operando estendido para 32 bits (para a divisão)
+static void x86_load(Compiler *c, const char *reg, const Node *node)
+{
+    char operand[MAX_TOKEN_LEN];
+    x86_operand(c, node, operand, sizeof(operand));
+    neander_buffer_printf(c->out, "    %s %s, %s\n", node->kind == NODE_CONST ? "mov" : "movzx", reg, operand);
+}
+
+// Calcula os operandos e depois o nó (uma vez por nó), deixando o valor em vals
+static void x86_node(Compiler *c, Node *node)
+{
+    if (node->kind != NODE_BINARY || node->mark == c->visit)
+        return;
+    node->mark = c->visit;
+    x86_node(c, node->left);
+    x86_node(c, node->right);
+
+    char l[MAX_TOKEN_LEN], r[MAX_TOKEN_LEN];
+    x86_operand(c, node->left, l, sizeof(l));
+    x86_operand(c, node->right, r, sizeof(r));
+    switch (node->op)
+    {
+    case '+':
+    case '-':
+        neander_buffer_printf(c->out, "    mov al, %s\n    %s al, %s\n", l, node->op == '+' ? "add" : "sub", r);
+        break;
+    case '*':
+        neander_buffer_printf(c->out, "    mov al, %s\n    mov cl, %s\n    mul cl\n", l, r);
+        break;
+    default:
+        // Divisor 0: quociente 255 e resto igual ao dividendo, como no código do Neander
+        x86_load(c, "eax", node->left);
+        x86_load(c, "ecx", node->right);
+        if (node->op == '/')
+            neander_buffer_printf(c->out, "    mov edx, 255\n    test ecx, ecx\n    jz 1f\n    div cl\n    mov edx, eax\n");
+        else
+            neander_buffer_printf(c->out, "    mov edx, eax\n    test ecx, ecx\n    jz 1f\n    div cl\n    movzx edx, ah\n");
+        neander_buffer_printf(c->out, "1:  mov al, dl\n");
+        break;
+    }
+    neander_buffer_printf(c->out, "    mov byte ptr [rip + vals + %d], al\n", node->id);
+}
+
+static void x86_definition(Compiler *c, Node *node, const char *name)
+{
+    char value[MAX_TOKEN_LEN];
+    x86_node(c, node);
+    x86_operand(c, node, value, sizeof(value));
+    neander_buffer_printf(c->out, "    mov al, %s\n    mov byte ptr [rip + vars + %d], al\n", value, native_var(c, name));
+}
+
+// Mesmo programa de write_c em assembly x86-64 do GNU as (System V, PIE), para montar com
+// "cc programa.s -o programa". A libc faz a leitura e a escrita
+static void write_x86(Compiler *c, Node *result, const char *target_name)
+{
+    int vars = native_var(c, NULL);
+
+    neander_buffer_printf(c->out,
+                  "# Gerado por compilador --target=x86\n"
+                  "    .intel_syntax noprefix\n"
+                  "    .text\n"
+                  "\n"
+                  "# Calcula as definições sobre vars. As folhas do grafo leem os valores do início (ins)\n"
+                  "run:\n"
+                  "    xor ecx, ecx\n"
+                  ".Lrun_copy:\n"
+                  "    lea rax, [rip + vars]\n"
+                  "    movzx edx, byte ptr [rax + rcx]\n"
+                  "    lea rax, [rip + ins]\n"
+                  "    mov byte ptr [rax + rcx], dl\n"
+                  "    inc ecx\n"
+                  "    cmp ecx, %d\n"
+                  "    jb .Lrun_copy\n",
+                  vars);
+    c->visit++;
+    for (Definition *d = c->definitions; d; d = d->next)
+        x86_definition(c, d->value, d->name);
+    if (result)
+        x86_definition(c, result, target_name);
+
+    neander_buffer_printf(c->out,
+                  "    ret\n"
+                  "\n"
+                  "# Volta as variáveis para os valores iniciais\n"
+                  "reset:\n"
+                  "    xor ecx, ecx\n"
+                  ".Lreset_loop:\n"
+                  "    lea rax, [rip + initial]\n"
+                  "    movzx edx, byte ptr [rax + rcx]\n"
+                  "    lea rax, [rip + vars]\n"
+                  "    mov byte ptr [rax + rcx], dl\n"
+                  "    inc ecx\n"
+                  "    cmp ecx, %d\n"
+                  "    jb .Lreset_loop\n"
+                  "    ret\n"
+                  "\n"
+                  "# Aplica o argumento NOME=valor em rdi\n"
+                  "assign:\n"
+                  "    push rbx\n"
+                  "    push r12\n"
+                  "    push r13\n"
+                  "    mov r12, rdi\n"
+                  "    xor ebx, ebx\n"
+                  ".Lassign_loop:\n"
+                  "    cmp ebx, %d\n"
+                  "    jae .Lassign_unknown\n"
+                  "    lea rax, [rip + names]\n"
+                  "    mov rdi, qword ptr [rax + rbx * 8]\n"
+                  "    call strlen@PLT\n"
+                  "    mov r13, rax\n"
+                  "    lea rax, [rip + names]\n"
+                  "    mov rsi, qword ptr [rax + rbx * 8]\n"
+                  "    mov rdi, r12\n"
+                  "    mov rdx, r13\n"
+                  "    call strncmp@PLT\n"
+                  "    test eax, eax\n"
+                  "    jne .Lassign_next\n"
+                  "    cmp byte ptr [r12 + r13], 61\n"
+                  "    jne .Lassign_next\n"
+                  "    lea rdi, [r12 + r13 + 1]\n"
+                  "    xor esi, esi\n"
+                  "    mov edx, 10\n"
+                  "    call strtol@PLT\n"
+                  "    lea rcx, [rip + vars]\n"
+                  "    mov byte ptr [rcx + rbx], al\n"
+                  "    pop r13\n"
+                  "    pop r12\n"
+                  "    pop rbx\n"
+                  "    ret\n"
+                  ".Lassign_next:\n"
+                  "    inc ebx\n"
+                  "    jmp .Lassign_loop\n"
+                  ".Lassign_unknown:\n"
+                  "    mov rax, qword ptr [rip + stderr@GOTPCREL]\n"
+                  "    mov rdi, qword ptr [rax]\n"
+                  "    lea rsi, [rip + .Lunknown]\n"
+                  "    mov rdx, r12\n"
+                  "    xor eax, eax\n"
+                  "    call fprintf@PLT\n"
+                  "    mov edi, 1\n"
+                  "    call exit@PLT\n"
+                  "\n"
+                  "# Escreve NOME=valor de cada variável em uma linha\n"
+                  "report:\n"
+                  "    push rbx\n"
+                  "    xor ebx, ebx\n"
+                  ".Lreport_loop:\n"
+                  "    lea rax, [rip + names]\n"
+                  "    mov rsi, qword ptr [rax + rbx * 8]\n"
+                  "    lea rax, [rip + vars]\n"
+                  "    movzx edx, byte ptr [rax + rbx]\n"
+                  "    mov ecx, 32\n"
+                  "    mov eax, 10\n"
+                  "    cmp ebx, %d\n"
+                  "    cmove ecx, eax\n"
+                  "    lea rdi, [rip + .Lformat]\n"
+                  "    xor eax, eax\n"
+                  "    call printf@PLT\n"
+                  "    inc ebx\n"
+                  "    cmp ebx, %d\n"
+                  "    jb .Lreport_loop\n"
+                  "    pop rbx\n"
+                  "    ret\n"
+                  "\n"
+                  "# Com argumentos: uma execução. Sem argumentos: uma execução por linha da entrada padrão,\n"
+                  "# sempre a partir dos valores iniciais\n"
+                  "    .globl main\n"
+                  "main:\n"
+                  "    push rbx\n"
+                  "    push r12\n"
+                  "    push r13\n"
+                  "    sub rsp, 1024\n"
+                  "    mov r12d, edi\n"
+                  "    mov r13, rsi\n"
+                  "    cmp r12d, 1\n"
+                  "    jle .Lmain_lines\n"
+                  "    call reset\n"
+                  "    mov ebx, 1\n"
+                  ".Lmain_args:\n"
+                  "    mov rdi, qword ptr [r13 + rbx * 8]\n"
+                  "    call assign\n"
+                  "    inc ebx\n"
+                  "    cmp ebx, r12d\n"
+                  "    jl .Lmain_args\n"
+                  "    call run\n"
+                  "    call report\n"
+                  "    jmp .Lmain_done\n"
+                  ".Lmain_lines:\n"
+                  "    mov rdi, rsp\n"
+                  "    mov esi, 1024\n"
+                  "    mov rax, qword ptr [rip + stdin@GOTPCREL]\n"
+                  "    mov rdx, qword ptr [rax]\n"
+                  "    call fgets@PLT\n"
+                  "    test rax, rax\n"
+                  "    je .Lmain_done\n"
+                  "    call reset\n"
+                  "    mov rdi, rsp\n"
+                  "    lea rsi, [rip + .Lseparators]\n"
+                  "    call strtok@PLT\n"
+                  ".Lmain_tokens:\n"
+                  "    test rax, rax\n"
+                  "    je .Lmain_run\n"
+                  "    mov rdi, rax\n"
+                  "    call assign\n"
+                  "    xor edi, edi\n"
+                  "    lea rsi, [rip + .Lseparators]\n"
+                  "    call strtok@PLT\n"
+                  "    jmp .Lmain_tokens\n"
+                  ".Lmain_run:\n"
+                  "    call run\n"
+                  "    call report\n"
+                  "    jmp .Lmain_lines\n"
+                  ".Lmain_done:\n"
+                  "    xor eax, eax\n"
+                  "    add rsp, 1024\n"
+                  "    pop r13\n"
+                  "    pop r12\n"
+                  "    pop rbx\n"
+                  "    ret\n"
+                  "\n"
+                  "    .section .rodata\n"
+                  "initial:\n"
+                  "    .byte ",
+                  vars, vars, vars - 1, vars);
+    native_vars(c, "%d", true);
+    neander_buffer_printf(c->out, "\n");
+    for (int i = 0; i < c->data.count; i++)
+    {
+        if (first_decl(c, i))
+            neander_buffer_printf(c->out, ".Lname%d:\n    .string \"%s\"\n", native_var(c, c->data.items[i].name), c->data.items[i].name);
+    }
+    neander_buffer_printf(c->out,
+                  ".Lformat:\n    .string \"%%s=%%d%%c\"\n"
+                  ".Lunknown:\n    .string \"Erro: variavel desconhecida em '%%s'\\n\"\n"
+                  ".Lseparators:\n    .string \" \\t\\r\\n\"\n"
+                  "\n"
+                  "    .section .data.rel.ro, \"aw\"\n"
+                  "    .p2align 3\n"
+                  "names:\n");
+    for (int i = 0; i < vars; i++)
+        neander_buffer_printf(c->out, "    .quad .Lname%d\n", i);
+    neander_buffer_printf(c->out,
+                  "\n"
+                  "    .bss\n"
+                  "vars:\n    .zero %d\n"
+                  "ins:\n    .zero %d\n"
+                  "vals:\n    .zero %d\n"
+                  "\n"
+                  "    .section .note.GNU-stack, \"\", @progbits\n",
+                  vars, vars, c->value_count + 1);
+}
+
+// Parser da seção de variáveis e código principal
+static void parse_conteudo(Compiler *c)
+{
+    // Processa declarações de variáveis
+    c->last_definition = &c->definitions;
+    while (c->current_token.type == TOKEN_LABEL)
+    {
+        const char *var_name = new_var(c, c->current_token.lexeme)->name;
+
+        advance(c);
+        expect(c, TOKEN_IGUAL);
+
+        // Verifica se a variavel está no formato NOME DB VALOR ou NOME DB EXPRESSAO
+        if (c->current_token.type == TOKEN_NUMERO)
+        {
+            neander_data_append(&c->data, var_name, c->current_token.lexeme, false);
+            advance(c);
+        }
+        else
+        {
+            Definition *d = compiler_alloc(c, sizeof(Definition));
+            d->name = var_name;
+            d->expr = expr(c);
+            *c->last_definition = d;
+            c->last_definition = &d->next;
+            neander_data_append(&c->data, var_name, "?", false);
+        }
+
+        expect(c, TOKEN_NOVA_LINHA);
+    }
+
+    expect(c, TOKEN_RES);
+    expect(c, TOKEN_IGUAL);
+
+    // A expressão do RES precisa ser igual à de uma variável, que recebe o resultado
+    Node *res = expr(c);
+    expect(c, TOKEN_NOVA_LINHA);
+
+    const char *target_name;
+    Node *result = number_program(c, res, &target_name);
+    if (c->options.target == TARGET_C)
+    {
+        write_c(c, result, target_name);
+        return;
+    }
+    if (c->options.target == TARGET_X86)
+    {
+        write_x86(c, result, target_name);
+        return;
+    }
+
+    lower_program(c, result, target_name);
+    neander_code_append(&c->code, OP_HLT, NULL);
+    lower_routines(c);
+
+    // Declara as constantes e temporárias usadas pelo código
+    for (int v = 0; v < 256; v++)
+    {
+        // _UM e _ZERO primeiro, como antes das demais constantes
+        int value = v < 2 ? 1 - v : v;
+        if (c->need_const[value])
+        {
+            char name[MAX_TOKEN_LEN], text[8];
+            snprintf(text, sizeof(text), "%d", value);
+            neander_data_append(&c->data, const_name(c, value, name), text, true);
+        }
+    }
+    for (int i = 0; i < c->temp_count; i++)
+    {
+        char name[MAX_TOKEN_LEN];
+        snprintf(name, sizeof(name), "_T%d", i);
+        neander_data_append(&c->data, name, "0", true);
+    }
+    for (int i = 0; i < c->shared_count; i++)
+    {
+        char name[MAX_TOKEN_LEN];
+        snprintf(name, sizeof(name), "_C%d", i);
+        neander_data_append(&c->data, name, "0", true);
+    }
+    static const char *mul_params[] = {"_MA", "_MB", "_MR"};
+    static const char *div_params[] = {"_DQ", "_DB", "_DR"};
+    for (int i = 0; i < 3; i++)
+    {
+        if (c->call_mul)
+            neander_data_append(&c->data, mul_params[i], "0", true);
+        if (c->call_div)
+            neander_data_append(&c->data, div_params[i], "0", true);
+    }
+
+    if (!c->options.no_peephole)
+        neander_code_peephole(&c->code);
+    if (!c->options.no_layout)
+    {
+        neander_code_layout(&c->code, &c->data);
+        // Auxiliares que passaram a dividir posição podem deixar cópias de uma posição para ela mesma
+        if (!c->options.no_peephole)
+            neander_code_peephole(&c->code);
+    }
+
+    if (c->options.extended)
+        neander_buffer_printf(c->out, ".EXT\n");
+    neander_code_export_labels(&c->code, c->options.extended, &c->data);
+    neander_buffer_printf(c->out, ".DATA\n");
+    neander_data_write(&c->data, c->out);
+    neander_buffer_printf(c->out, "\n.CODE\n.ORG 0\n");
+    neander_code_write(&c->code, c->options.extended, c->out);
+}
+
+// Parser do bloco INICIO...FIM
+static void parse_inicio(Compiler *c)
+{
+    expect(c, TOKEN_INICIO);
+    expect(c, TOKEN_NOVA_LINHA);
+    parse_conteudo(c);
+    expect(c, TOKEN_FIM);
+}
+
+// Parser do programa principal
+static void parse_programa(Compiler *c)
+{
+    expect(c, TOKEN_PROGRAMA);
+    expect(c, TOKEN_ASPAS);
+    expect(c, TOKEN_LABEL);
+    expect(c, TOKEN_ASPAS);
+    expect(c, TOKEN_DOIS_PONTOS);
+    expect(c, TOKEN_NOVA_LINHA);
+    parse_inicio(c);
+}
+
+// Compila o programa em source para assembly do Neander, acrescentado em out.
+// O parser monta a árvore sintática (na arena), que é traduzida para a lista de instruções;
+// as otimizações trabalham sobre a lista e o assembly só é escrito no fim, com os endereços calculados.
+// Retorna NEANDER_OK, NEANDER_ERROR com a mensagem em error, ou NEANDER_NO_MEMORY (out fica incompleto)
+NeanderResult neander_compile(const char *source, size_t len, const CompileOptions *options, NeanderBuffer *out,
+                    char *error, size_t error_size)
+{
+    Compiler c = {0};
+    c.source = source;
+    c.len = len;
+    c.out = out;
+    if (options)
+        c.options = *options;
+    // Nos alvos nativos os valores das variáveis são entradas do executável: nada é calculado na compilação
+    if (c.options.target != TARGET_NEANDER)
+        c.options.no_fold = 1;
+    c.error = error;
+    c.error_size = error_size;
+
+    volatile NeanderResult status = NEANDER_OK;    // volatile: mantém o valor depois do longjmp
+    if (setjmp(c.fail))
+        status = NEANDER_ERROR;
+    else
+    {
+        advance(&c);
+        parse_programa(&c);
+    }
+    // Uma alocação que falhou em qualquer etapa deixa a sua marca (a compilação pode ter continuado)
+    if (c.arena.failed || c.code.failed || c.data.failed || out->failed)
+    {
+        snprintf(error, error_size, "memoria insuficiente");
+        status = NEANDER_NO_MEMORY;
+    }
+
+    neander_arena_free(&c.arena);
+    neander_code_free(&c.code);
+    neander_data_free(&c.data);
+    return status;
+}
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "neander.h"
+
+// Declarações do .DATA e passada de layout. As variáveis do programa ficam onde foram declaradas
+// (os endereços delas são a interface do programa); as auxiliares do compilador passam por uma
+// análise de vida e dividem posições quando os intervalos de uso não se sobrepõem
+
+#define MAX_DEPTH 4     // Profundidade de laço considerada no peso de cada acesso
+
+// Acrescenta uma declaração ao .DATA. Sem memória marca data->failed
+void neander_data_append(DataList *data, const char *name, const char *value, int temporary) {
+    if (data->count == data->capacity) {
+        int capacity = data->capacity ? data->capacity * 2 : 32;
+        DataDecl *items = neander_alloc(data->items, capacity, sizeof(DataDecl), &data->failed);
+        if (!items) return;
+        data->items = items;
+        data->capacity = capacity;
+    }
+    DataDecl *decl = &data->items[data->count++];
+    snprintf(decl->name, sizeof(decl->name), "%s", name);
+    snprintf(decl->value, sizeof(decl->value), "%s", value);
+    decl->temporary = temporary;
+}
+
+void neander_data_write(const DataList *data, NeanderBuffer *out) {
+    for (int i = 0; i < data->count; i++) {
+        neander_buffer_printf(out, "%s DB %s\n", data->items[i].name, data->items[i].value);
+    }
+}
+
+void neander_data_free(DataList *data) {
+    free(data->items);
+    data->items = NULL;
+    data->count = data->capacity = 0;
+    data->failed = 0;
+}
+
+// Índice da auxiliar com esse nome em temps, ou -1
+static int temp_index(const DataDecl **temps, int count, const char *name) {
+    for (int t = 0; t < count; t++) {
+        if (strcmp(temps[t]->name, name) == 0) return t;
+    }
+    return -1;
+}
+
+// Valor inicial de uma declaração, como o assembler grava ("?" vale 0)
+uint8_t neander_initial_value(const DataDecl *decl) {
+    return strcmp(decl->value, "?") == 0 ? 0 : (uint8_t)atoi(decl->value);
+}
+
+// Conjuntos de auxiliares: words palavras de 32 bits por conjunto, count conjuntos zerados em sequência
+// (NULL sem memória, marcando *failed)
+static uint32_t *set_alloc(size_t count, int words, int *failed) {
+    uint32_t *sets = neander_alloc(NULL, count * words, sizeof(uint32_t), failed);
+    if (sets) memset(sets, 0, count * words * sizeof(uint32_t));
+    return sets;
+}
+
+static int set_has(const uint32_t *set, int t) {
+    return set[t / 32] >> (t % 32) & 1;
+}
+
+static void set_add(uint32_t *set, int t) {
+    set[t / 32] |= 1u << (t % 32);
+}
+
+static void set_remove(uint32_t *set, int t) {
+    set[t / 32] &= ~(1u << (t % 32));
+}
+
+static void set_union(uint32_t *set, const uint32_t *other, int words) {
+    for (int w = 0; w < words; w++) set[w] |= other[w];
+}
+
+// 1 se os conjuntos têm alguma auxiliar em comum
+static int set_meets(const uint32_t *set, const uint32_t *other, int words) {
+    for (int w = 0; w < words; w++) {
+        if (set[w] & other[w]) return 1;
+    }
+    return 0;
+}
+
+// Auxiliares vivas na saída da instrução i, em out. returns: vivas em algum ponto de retorno de sub-rotina
+static void live_out(const CodeList *code, const int *label_pos, const uint32_t *live_in, const uint32_t *returns,
+              int words, int i, uint32_t *out) {
+    const Instr *instr = &code->items[i];
+    memset(out, 0, words * sizeof(uint32_t));
+    if (instr->op != OP_HLT && instr->op != OP_JMP && instr->op != OP_RET) set_union(out, live_in + (i + 1) * words, words);
+    if (neander_is_jump(instr->op)) set_union(out, live_in + label_pos[instr->target] * words, words);
+    if (instr->op == OP_RET) set_union(out, returns, words);
+}
+
+// Passada de layout das auxiliares:
+//   - análise de vida sobre o grafo de fluxo do código (desvios por rótulo);
+//   - duas auxiliares interferem se uma é escrita enquanto a outra está viva, ou se as duas
+//     estão vivas na entrada com valores iniciais diferentes (constantes como _UM e _ZERO só dividem
+//     posição com auxiliares de mesmo valor inicial);
+//   - coloração gulosa, das mais acessadas para as menos, e as posições saem em ordem de peso
+//     (acessos dentro de laços valem mais), as mais usadas logo depois das variáveis declaradas antes delas;
+//   - escritas em auxiliares que não são lidas depois são removidas, e auxiliares que o código
+//     não usa mais não ocupam memória.
+// Sem memória o código e o .DATA ficam como estão e code->failed é marcado
+void neander_code_layout(CodeList *code, DataList *data) {
+    const DataDecl **temps = neander_alloc(NULL, data->count, sizeof(DataDecl *), &code->failed);
+    int temp_count = 0;
+
+    if (!temps) return;
+
+    // Um nome só é auxiliar se nenhuma declaração do programa usa o mesmo nome
+    for (int i = 0; i < data->count; i++) {
+        const DataDecl *decl = &data->items[i];
+        if (!decl->temporary || temp_index(temps, temp_count, decl->name) >= 0) continue;
+        int user = 0;
+        for (int j = 0; j < data->count; j++) {
+            if (!data->items[j].temporary && strcmp(data->items[j].name, decl->name) == 0) user = 1;
+        }
+        if (user) continue;
+        temps[temp_count++] = decl;
+    }
+    if (temp_count == 0) {
+        free(temps);
+        return;
+    }
+
+    // Toda a memória da passada é reservada aqui: sem ela nada é alterado
+    int n = code->count;
+    int words = (temp_count + 31) / 32;
+    int *failed = &code->failed;
+    int *label_pos = neander_alloc(NULL, code->labels + 1, sizeof(int), failed);
+    int *depth = neander_alloc(NULL, n + 1, sizeof(int), failed);
+    int *temp = neander_alloc(NULL, n + 1, sizeof(int), failed);
+    char *keep = neander_alloc(NULL, n + 1, 1, failed);
+    uint32_t *live_in = set_alloc(n + 1, words, failed);
+    uint32_t *interference = set_alloc(temp_count, words, failed);
+    uint32_t *returns = set_alloc(1, words, failed), *out = set_alloc(1, words, failed), *in = set_alloc(1, words, failed);
+    uint64_t *weight = neander_alloc(NULL, temp_count, sizeof(uint64_t), failed);
+    int *used = neander_alloc(NULL, temp_count, sizeof(int), failed);
+    int *order = neander_alloc(NULL, temp_count, sizeof(int), failed);
+    int *slot_of = neander_alloc(NULL, temp_count, sizeof(int), failed);
+    int *slot_rep = neander_alloc(NULL, temp_count, sizeof(int), failed);
+    int *slot_init = neander_alloc(NULL, temp_count, sizeof(int), failed);
+    uint32_t *slot_members = set_alloc(temp_count, words, failed);
+    uint64_t *slot_weight = neander_alloc(NULL, temp_count, sizeof(uint64_t), failed);
+    char *done = neander_alloc(NULL, temp_count + 1, 1, failed);
+    DataList layout = {0};
+    if (*failed) goto cleanup;
+
+    memset(depth, 0, (n + 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        const Instr *instr = &code->items[i];
+        if (instr->op == OP_LABEL) label_pos[instr->target] = i;
+        temp[i] = instr->operand[0] && instr->op != OP_LABEL ? temp_index(temps, temp_count, instr->operand) : -1;
+    }
+
+    // Profundidade de laço: cada desvio para trás envolve as instruções entre o rótulo e ele
+    for (int i = 0; i < n; i++) {
+        if (!neander_is_jump(code->items[i].op) || label_pos[code->items[i].target] > i) continue;
+        for (int j = label_pos[code->items[i].target]; j <= i; j++) depth[j]++;
+    }
+
+    // Vida das auxiliares (de trás para frente, até estabilizar por causa dos laços).
+    // Um retorno de sub-rotina pode voltar para qualquer rótulo exportado (os pontos de retorno)
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        memset(returns, 0, words * sizeof(uint32_t));
+        for (int i = 0; i < n; i++) {
+            if (code->items[i].op == OP_LABEL && code->items[i].operand[0]) set_union(returns, live_in + i * words, words);
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            const Instr *instr = &code->items[i];
+            live_out(code, label_pos, live_in, returns, words, i, out);
+
+            memcpy(in, out, words * sizeof(uint32_t));
+            if (temp[i] >= 0 && instr->op == OP_STA) {
+                set_remove(in, temp[i]);
+                set_union(interference + temp[i] * words, out, words);
+                set_remove(interference + temp[i] * words, temp[i]);
+            }
+            if (temp[i] >= 0 && neander_reads_operand(instr->op)) set_add(in, temp[i]);
+            if (memcmp(in, live_in + i * words, words * sizeof(uint32_t)) != 0) {
+                memcpy(live_in + i * words, in, words * sizeof(uint32_t));
+                changed = 1;
+            }
+        }
+    }
+
+    // Escritas mortas: a auxiliar não está viva depois do STA (o resultado ficou só no AC)
+    for (int i = 0; i < n; i++) {
+        keep[i] = 1;
+        if (temp[i] < 0 || code->items[i].op != OP_STA) continue;
+        live_out(code, label_pos, live_in, returns, words, i, out);
+        if (!set_has(out, temp[i])) {
+            keep[i] = 0;
+            temp[i] = -1;
+        }
+    }
+
+    // Vivas na entrada: o valor inicial é lido, então só dividem posição com o mesmo valor
+    const uint32_t *entry = live_in;
+    for (int t = 0; t < temp_count; t++) {
+        for (int u = 0; u < temp_count; u++) {
+            if (t != u && set_has(entry, t) && set_has(entry, u) && neander_initial_value(temps[t]) != neander_initial_value(temps[u])) {
+                set_add(interference + t * words, u);
+            }
+        }
+    }
+    for (int t = 0; t < temp_count; t++) {
+        for (int u = 0; u < temp_count; u++) {
+            if (set_has(interference + t * words, u)) set_add(interference + u * words, t);
+        }
+    }
+
+    // Peso de cada auxiliar: acessos, multiplicados por 8 a cada nível de laço
+    memset(weight, 0, temp_count * sizeof(uint64_t));
+    memset(used, 0, temp_count * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        if (temp[i] < 0) continue;
+        weight[temp[i]] += 1ull << (3 * (depth[i] < MAX_DEPTH ? depth[i] : MAX_DEPTH));
+        used[temp[i]] = 1;
+    }
+
+    // Coloração gulosa em ordem de peso; slot_of[t] = posição, slot_rep[s] = auxiliar que dá nome à posição
+    int slot_count = 0;
+
+    for (int t = 0; t < temp_count; t++) order[t] = t;
+    for (int a = 1; a < temp_count; a++) {
+        int t = order[a], b = a;
+        while (b > 0 && weight[order[b - 1]] < weight[t]) {
+            order[b] = order[b - 1];
+            b--;
+        }
+        order[b] = t;
+    }
+
+    for (int k = 0; k < temp_count; k++) {
+        int t = order[k];
+        slot_of[t] = -1;
+        if (!used[t]) continue;
+
+        int s = 0;
+        while (s < slot_count && set_meets(slot_members + s * words, interference + t * words, words)) s++;
+        if (s == slot_count) {
+            slot_rep[s] = t;
+            slot_init[s] = t;
+            slot_weight[s] = 0;
+            slot_count++;
+        }
+        set_add(slot_members + s * words, t);
+        slot_weight[s] += weight[t];
+        if (set_has(entry, t)) slot_init[s] = t;    // A posição começa com o valor de quem é lida antes de ser escrita
+        slot_of[t] = s;
+    }
+
+    // Renomeia os operandos para o nome da posição
+    for (int i = 0; i < n; i++) {
+        if (temp[i] < 0) continue;
+        snprintf(code->items[i].operand, MAX_OPERAND_LEN, "%s", temps[slot_rep[slot_of[temp[i]]]]->name);
+    }
+
+    // Refaz o .DATA: as posições entram no lugar da primeira auxiliar declarada, das mais pesadas para as mais leves
+    int placed = 0;
+    for (int i = 0; i < data->count; i++) {
+        const DataDecl *decl = &data->items[i];
+        if (temp_index(temps, temp_count, decl->name) < 0) {
+            neander_data_append(&layout, decl->name, decl->value, decl->temporary);
+            continue;
+        }
+        if (placed) continue;
+        placed = 1;
+
+        memset(done, 0, slot_count + 1);
+        for (int k = 0; k < slot_count; k++) {
+            int best = -1;
+            for (int s = 0; s < slot_count; s++) {
+                if (!done[s] && (best < 0 || slot_weight[s] > slot_weight[best])) best = s;
+            }
+            done[best] = 1;
+            neander_data_append(&layout, temps[slot_rep[best]]->name, temps[slot_init[best]]->value, 1);
+        }
+    }
+
+    neander_data_free(data);
+    *data = layout;     // Inclusive a marca de falta de memória
+    neander_code_filter(code, keep);
+
+cleanup:
+    free(keep);
+    free(temps);
+    free(label_pos);
+    free(depth);
+    free(temp);
+    free(live_in);
+    free(interference);
+    free(returns);
+    free(out);
+    free(in);
+    free(weight);
+    free(used);
+    free(order);
+    free(slot_of);
+    free(slot_rep);
+    free(slot_init);
+    free(slot_members);
+    free(slot_weight);
+    free(done);
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#include "neander.h"
+
+// Leitura do banco do superotimizador (formato em neander.h) e busca de um padrão nele
+
+// Grava a mensagem de erro da linha line em error e retorna -1
+static int superopt_error(char *error, size_t error_size, int line, const char *format, ...) {
+    va_list args;
+    int len = snprintf(error, error_size, "banco do superotimizador, linha %d: ", line);
+
+    va_start(args, format);
+    if (len >= 0 && (size_t)len < error_size) vsnprintf(error + len, error_size - len, format, args);
+    va_end(args);
+    return -1;
+}
+
+// Lê uma instrução ("LDA x", "AND #3", "NOT"). Retorna 0, ou -1 se o texto não é uma instrução válida
+static int parse_superopt_instr(const char *text, SuperoptInstr *instr) {
+    char mnemonic[8], operand[8], extra;
+    int fields = sscanf(text, "%7s %7s %c", mnemonic, operand, &extra);
+
+    if (fields < 1 || fields > 2) return -1;
+    instr->op = OP_NOP;
+    for (Op op = OP_STA; op <= OP_NOT; op++) {
+        if (strcmp(mnemonic, neander_op_names[op]) == 0) instr->op = op;
+    }
+    if (instr->op == OP_NOP || (instr->op == OP_NOT) != (fields == 1)) return -1;
+
+    instr->operand = 0;
+    instr->value = 0;
+    if (fields == 1) return 0;
+    if (operand[0] == '#') {
+        char *end;
+        long value = strtol(operand + 1, &end, 10);
+        if (!isdigit((unsigned char)operand[1]) || *end || value > 255) return -1;
+        instr->operand = '#';
+        instr->value = (uint8_t)value;
+    } else if (strchr("xyzt", operand[0]) && operand[1] == '\0') {
+        instr->operand = operand[0];
+    } else {
+        return -1;
+    }
+    // A sequência só escreve na temporária
+    return instr->op == OP_STA && instr->operand != 't' ? -1 : 0;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const SuperoptEntry *)a)->pattern, ((const SuperoptEntry *)b)->pattern);
+}
+
+NeanderResult neander_superopt_parse(const char *source, size_t len, SuperoptDb *db, char *error, size_t error_size) {
+    const char *end = source + len;
+    int line_number = 0;
+    int failed = 0;
+
+    while (source < end) {
+        const char *eol = memchr(source, '\n', end - source);
+        if (!eol) eol = end;
+        char line[512];
+        size_t n = eol - source;
+        line_number++;
+        if (n >= sizeof(line)) return superopt_error(error, error_size, line_number, "linha longa demais");
+        memcpy(line, source, n);
+        line[n] = '\0';
+        source = eol < end ? eol + 1 : end;
+
+        // Linhas em branco e comentários (# no começo da linha) são ignorados
+        line[strcspn(line, "\r")] = '\0';
+        size_t indent = strspn(line, " \t");
+        if (line[indent] == '\0' || line[indent] == '#') continue;
+
+        char *equals = strstr(line, " = ");
+        if (!equals) return superopt_error(error, error_size, line_number, "esperado '<padrao> = <instrucoes>'");
+        *equals = '\0';
+
+        if (db->count == db->capacity) {
+            int capacity = db->capacity ? db->capacity * 2 : 256;
+            SuperoptEntry *items = neander_alloc(db->items, capacity, sizeof(SuperoptEntry), &failed);
+            if (!items) {
+                snprintf(error, error_size, "memoria insuficiente");
+                return NEANDER_NO_MEMORY;
+            }
+            db->items = items;
+            db->capacity = capacity;
+        }
+        SuperoptEntry *entry = &db->items[db->count];
+        char *pattern = line + indent;
+        if (strlen(pattern) >= SUPEROPT_PATTERN_LEN || strpbrk(pattern, " \t")) {
+            return superopt_error(error, error_size, line_number, "padrao invalido '%s'", pattern);
+        }
+        strcpy(entry->pattern, pattern);
+
+        // Instruções separadas por ';'
+        entry->length = 0;
+        for (char *text = equals + 3; text; ) {
+            char *next = strchr(text, ';');
+            if (next) *next++ = '\0';
+            if (entry->length == SUPEROPT_MAX_LEN) {
+                return superopt_error(error, error_size, line_number, "sequencia com mais de %d instrucoes", SUPEROPT_MAX_LEN);
+            }
+            if (parse_superopt_instr(text, &entry->code[entry->length++]) != 0) {
+                return superopt_error(error, error_size, line_number, "instrucao invalida '%s'", text);
+            }
+            text = next;
+        }
+        if (entry->length == 0 || entry->code[0].op != OP_LDA || entry->code[0].operand == 't') {
+            return superopt_error(error, error_size, line_number, "a sequencia deve comecar com LDA de uma folha ou constante");
+        }
+        db->count++;
+    }
+
+    qsort(db->items, db->count, sizeof(SuperoptEntry), compare_entries);
+    return NEANDER_OK;
+}
+
+// Sequência do padrão, ou NULL se o banco não tem o padrão
+const SuperoptEntry *neander_superopt_find(const SuperoptDb *db, const char *pattern) {
+    SuperoptEntry key;
+
+    if (!db || db->count == 0 || strlen(pattern) >= SUPEROPT_PATTERN_LEN) return NULL;
+    strcpy(key.pattern, pattern);
+    return bsearch(&key, db->items, db->count, sizeof(SuperoptEntry), compare_entries);
+}
+
+void neander_superopt_free(SuperoptDb *db) {
+    free(db->items);
+    db->items = NULL;
+    db->count = db->capacity = 0;
+}
@@ -0,0 +1,1488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "neander.h"
+
+// Máquina Neander da libneander: carga de imagens, motores de execução e relatórios
+
+static const uint8_t ext_zero_page[EXT_PAGE_SIZE] = {0};
+
+// Retorna o mnemônico correspondente ao opcode
+const char* neander_get_mnemonic(uint8_t opcode) {
+    switch (opcode & 0xF0) {
+        case 0x00: return "NOP";
+        case 0x10: return "STA";
+        case 0x20: return "LDA";
+        case 0x30: return "ADD";
+        case 0x40: return "OR";
+        case 0x50: return "AND";
+        case 0x60: return "NOT";
+        case 0x80: return "JMP";
+        case 0x90: return "JN";
+        case 0xA0: return "JZ";
+        case 0xF0: return "HLT";
+        default: return "";
+    }
+}
+
+// Verifica se a próxima instrução ocupa 2 bytes (opcode + operando)
+int neander_should_skip_next(const char* mnemonic) {
+    // Somente NOT, NOP e HLT são de 1 byte
+    return (mnemonic[0] != '\0' && strcmp(mnemonic, "NOP") != 0 && strcmp(mnemonic, "HLT") != 0 && strcmp(mnemonic, "NOT") != 0);
+}
+
+// Lê um inteiro little-endian de 16 ou 32 bits
+static uint32_t read_le(const uint8_t *p, int bytes) {
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+// Destino dos trechos decodificados de uma imagem (memória normal ou do modo estendido)
+typedef void (*ImageStore)(void *target, uint32_t address, const uint8_t *bytes, uint32_t length);
+
+// Copia um trecho da imagem para a memória de 256 bytes
+static void store_flat(void *target, uint32_t address, const uint8_t *bytes, uint32_t length) {
+    memcpy((uint8_t *)target + address, bytes, length);
+}
+
+// Inicia uma instância do modo estendido sem nenhuma página alocada
+void neander_ext_init(NeanderExt *vm) {
+    memset(vm, 0, sizeof(NeanderExt));
+    for (int i = 0; i < EXT_PAGES; i++) {
+        vm->pages[i] = (uint8_t *)ext_zero_page;
+    }
+}
+
+// Libera as páginas alocadas de uma instância do modo estendido
+void neander_ext_free(NeanderExt *vm) {
+    for (int i = 0; i < EXT_PAGES; i++) {
+        if (vm->pages[i] != ext_zero_page) free(vm->pages[i]);
+        vm->pages[i] = (uint8_t *)ext_zero_page;
+    }
+    vm->pages_used = 0;
+}
+
+// Lê um byte da memória estendida
+static uint8_t ext_read(const NeanderExt *vm, uint32_t address) {
+    return vm->pages[address >> 8][address & 0xFF];
+}
+
+// Escreve um byte na memória estendida, alocando a página na primeira escrita diferente de zero.
+// Retorna 0, ou -1 se a página não pôde ser alocada (o byte não é escrito e vm->failed é marcado)
+static int ext_write(NeanderExt *vm, uint32_t address, uint8_t value) {
+    uint8_t **page = &vm->pages[address >> 8];
+    if (*page == ext_zero_page) {
+        if (value == 0) return 0;
+        uint8_t *data = neander_alloc(NULL, 1, EXT_PAGE_SIZE, &vm->failed);
+        if (!data) return -1;
+        memset(data, 0, EXT_PAGE_SIZE);
+        *page = data;
+        vm->pages_used++;
+    }
+    (*page)[address & 0xFF] = value;
+    return 0;
+}
+
+// Copia um trecho da imagem para a memória estendida
+static void store_ext(void *target, uint32_t address, const uint8_t *bytes, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        ext_write(target, address + i, bytes[i]);
+    }
+}
+
+// Decodifica uma imagem no formato compacto (ver COMPACT_HEADER) em uma memória de mem_size bytes
+static int parse_compact(const uint8_t *data, size_t size, uint32_t mem_size, ImageStore store, void *target) {
+    if (size < COMPACT_HEADER_SIZE || data[4] != COMPACT_VERSION) return LOAD_ERR_FORMAT;
+
+    uint8_t flags = data[5];
+    uint32_t count = read_le(data + 8, 4);
+    const uint8_t *p = data + COMPACT_HEADER_SIZE;
+    const uint8_t *end = data + size;
+
+    if (!(flags & COMPACT_SPARSE)) {
+        // Denso: os bytes da memória em sequência, sem os zeros finais
+        if (count > mem_size || (size_t)(end - p) < count) return LOAD_ERR_FORMAT;
+        store(target, 0, p, count);
+        return LOAD_OK;
+    }
+
+    // Esparso: count trechos [endereço LE16][tamanho LE16][bytes]
+    for (uint32_t i = 0; i < count; i++) {
+        if (end - p < 4) return LOAD_ERR_FORMAT;
+        uint32_t address = read_le(p, 2), length = read_le(p + 2, 2);
+        p += 4;
+        if (address + length > mem_size || (uint32_t)(end - p) < length) return LOAD_ERR_FORMAT;
+        store(target, address, p, length);
+        p += length;
+    }
+    return LOAD_OK;
+}
+
+// Decodifica uma imagem no formato original: cada byte da memória seguido de um separador 0x00
+static int parse_padded(const uint8_t *data, size_t size, uint8_t *memory) {
+    size_t count = (size - 4 + 1) / 2;
+    if (count > MEM_SIZE) count = MEM_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        memory[i] = data[4 + 2 * i];
+    }
+    return LOAD_OK;
+}
+
+// Mapeia o arquivo de imagem com mmap (liberar com munmap)
+static int map_image(const char *filename, const uint8_t **data, size_t *size) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return LOAD_ERR_OPEN;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 4) {
+        close(fd);
+        return LOAD_ERR_FORMAT;
+    }
+
+    *size = st.st_size;
+    *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (*data == MAP_FAILED) {
+        return LOAD_ERR_OPEN;
+    }
+    return LOAD_OK;
+}
+
+// Decodifica uma imagem que já está na memória (arquivo mapeado ou gerada por neander_assemble)
+// Imagens do modo estendido retornam LOAD_ERR_EXTENDED
+int neander_load_image_data(const uint8_t *data, size_t size, uint8_t *memory) {
+    static const uint8_t padded_header[] = MAGIC_HEADER;
+    static const uint8_t compact_header[] = COMPACT_HEADER;
+
+    // Valida o cabeçalho e escolhe o formato
+    if (size < HEADER_SIZE) {
+        return LOAD_ERR_FORMAT;
+    }
+    if (memcmp(data, padded_header, HEADER_SIZE) == 0) {
+        return parse_padded(data, size, memory);
+    }
+    if (memcmp(data, compact_header, HEADER_SIZE) == 0) {
+        if (size > 5 && (data[5] & COMPACT_EXTENDED)) {
+            return LOAD_ERR_EXTENDED;
+        }
+        return parse_compact(data, size, MEM_SIZE, store_flat, memory);
+    }
+    return LOAD_ERR_FORMAT;
+}
+
+// Decodifica uma imagem do modo estendido (formato compacto com COMPACT_EXTENDED) em vm, já iniciada
+int neander_load_ext_image_data(const uint8_t *data, size_t size, NeanderExt *vm) {
+    static const uint8_t compact_header[] = COMPACT_HEADER;
+
+    if (size > 5 && memcmp(data, compact_header, HEADER_SIZE) == 0 && (data[5] & COMPACT_EXTENDED)) {
+        int status = parse_compact(data, size, EXT_MEM_SIZE, store_ext, vm);
+        return status == LOAD_OK && vm->failed ? LOAD_ERR_MEMORY : status;
+    }
+    return LOAD_ERR_FORMAT;
+}
+
+// Carrega o conteúdo do arquivo .mem na memória simulada, sem encerrar o programa em caso de erro
+// O arquivo é mapeado com mmap e decodificado direto do mapeamento, em qualquer formato
+int neander_load_image(const char *filename, uint8_t *memory) {
+    const uint8_t *data;
+    size_t size;
+    int status = map_image(filename, &data, &size);
+    if (status != LOAD_OK) {
+        return status;
+    }
+
+    status = neander_load_image_data(data, size, memory);
+    munmap((void *)data, size);
+    return status;
+}
+
+// Carrega uma imagem do modo estendido em vm, já iniciada
+int neander_load_ext_image(const char *filename, NeanderExt *vm) {
+    const uint8_t *data;
+    size_t size;
+    int status = map_image(filename, &data, &size);
+    if (status != LOAD_OK) {
+        return status;
+    }
+
+    status = neander_load_ext_image_data(data, size, vm);
+    munmap((void *)data, size);
+    return status;
+}
+
+#define REPORT_SIZE 16384   // Reserva inicial do relatório: cabe o formato detalhado (duas listagens da memória)
+
+// Relatório montado em memória (o buffer cresce até caber o relatório inteiro) e escrito de uma vez
+// só na saída padrão, ou montado direto em out
+typedef struct {
+    NeanderBuffer text;
+    NeanderBuffer *out;     // Destino do relatório (NULL: saída padrão)
+} Report;
+
+// Buffer onde o relatório é montado: o próprio r->out, ou o texto que vai para a saída padrão
+static NeanderBuffer *report_target(Report *r) {
+    return r->out ? r->out : &r->text;
+}
+
+// Formato do relatório pelo nome usado nas opções (verbose, summary, diff ou binary).
+// Retorna 0, ou -1 se o nome é desconhecido
+int neander_output_format(const char *name, OutputFormat *format) {
+    static const char *names[] = {"verbose", "summary", "diff", "binary"};
+    for (int f = 0; f < (int)(sizeof(names) / sizeof(names[0])); f++) {
+        if (strcmp(name, names[f]) == 0) {
+            *format = (OutputFormat)f;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Prepara um relatório vazio, com espaço para o formato detalhado sem crescer (sem memória o buffer
+// fica marcado, nada é acrescentado e report_flush devolve NEANDER_NO_MEMORY)
+static void report_init(Report *r, NeanderBuffer *out) {
+    r->text = (NeanderBuffer){0};
+    r->out = out;
+    neander_buffer_reserve(report_target(r), REPORT_SIZE);
+}
+
+// Termina o relatório: escreve o texto inteiro na saída padrão com uma única chamada a write
+// (repetida só se for parcial); em r->out o relatório já está completo. Um relatório incompleto
+// (sem memória) não é escrito. Retorna NEANDER_OK, NEANDER_NO_MEMORY ou NEANDER_ERROR (erro de escrita)
+static NeanderResult report_flush(Report *r) {
+    NeanderResult result = NEANDER_OK;
+    size_t done = 0;
+
+    if (r->out) {
+        if (r->out->failed) return NEANDER_NO_MEMORY;
+        r->out->data[r->out->len] = '\0';
+        return NEANDER_OK;
+    }
+    if (r->text.failed) result = NEANDER_NO_MEMORY;
+    fflush(stdout);  // Mantém a ordem com o que já foi escrito por printf
+    while (result == NEANDER_OK && done < r->text.len) {
+        ssize_t n = write(STDOUT_FILENO, r->text.data + done, r->text.len - done);
+        if (n < 0) result = NEANDER_ERROR;
+        else done += n;
+    }
+    neander_buffer_free(&r->text);
+    return result;
+}
+
+// Garante espaço para size bytes no relatório (o buffer cresce; nada é escrito antes do fim).
+// Retorna NULL sem memória
+static char *report_reserve(Report *r, size_t size) {
+    NeanderBuffer *b = report_target(r);
+    if (neander_buffer_reserve(b, size) != 0) return NULL;
+    return b->data + b->len;
+}
+
+static void report_bytes(Report *r, const void *data, size_t size) {
+    char *p = report_reserve(r, size);
+    if (!p) return;
+    memcpy(p, data, size);
+    report_target(r)->len += size;
+}
+
+static void report_str(Report *r, const char *s) {
+    report_bytes(r, s, strlen(s));
+}
+
+// Acrescenta um byte em hexadecimal (dois dígitos maiúsculos)
+static void report_hex(Report *r, uint8_t value) {
+    static const char digits[] = "0123456789ABCDEF";
+    char *p = report_reserve(r, 2);
+    if (!p) return;
+    p[0] = digits[value >> 4];
+    p[1] = digits[value & 0x0F];
+    report_target(r)->len += 2;
+}
+
+static void report_printf(Report *r, const char *format, ...) {
+    char line[256];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+    if (len > 0) report_bytes(r, line, len);
+}
+
+// Acrescenta a listagem da memória (endereço, valor e mnemônico) ao relatório
+static void report_memory(Report *r, const uint8_t *memory) {
+    report_str(r, "Reg\tValor\tMnemonico\n");
+    int show_mnemonic = 1;  // Flag para controlar exibição de mnemônicos
+    
+    for (int i = 0; i < MEM_SIZE; i++) {
+        const char *mnemonic = show_mnemonic ? neander_get_mnemonic(memory[i]) : "";
+        
+        report_hex(r, i);
+        report_str(r, "\t");
+        report_hex(r, memory[i]);
+        report_str(r, "\t");
+        report_str(r, mnemonic);
+        if (neander_should_skip_next(mnemonic) && i + 1 < MEM_SIZE) {
+            report_str(r, " ");
+            report_hex(r, memory[i + 1]);
+            show_mnemonic = 0;
+        } else {
+            // Controla se o próximo byte deve mostrar mnemônico ou não
+            if (strcmp(mnemonic, "NOP") == 0 || strcmp(mnemonic, "HLT") == 0 || strcmp(mnemonic, "NOT") == 0) {
+                show_mnemonic = 1;
+            } else {
+                show_mnemonic = (mnemonic[0] == '\0');
+            }
+        }
+        report_str(r, "\n");
+    }
+}
+
+// Define o limite de desvios tomados de uma instância (0 = sem limite)
+void neander_set_jump_limit(Neander *vm, uint64_t limit) {
+    vm->jumps_left = limit ? limit : JUMPS_UNLIMITED;
+}
+
+// Registra uma instrução executada no perfil
+static void profile_step(Profile *p, int pc, uint8_t op, uint8_t address, int taken) {
+    p->total++;
+    p->exec[pc]++;
+
+    switch (op) {
+        case 0x10: p->writes[address]++; break;
+        case 0x20: case 0x30: case 0x40: case 0x50: p->reads[address]++; break;
+        case 0x80: case 0x90: case 0xA0:
+            if (taken) {
+                p->taken[pc]++;
+                p->target[pc] = address;
+            } else {
+                p->not_taken[pc]++;
+            }
+            break;
+    }
+}
+
+// Executa o programa com o interpretador de referência (fetch + switch a cada passo)
+// A execução continua a partir do estado atual da instância (AC, PC, N e Z)
+// Quando prof não é NULL, cada instrução executada é registrada no perfil
+// Retorna a quantidade de instruções executadas, usada pelo benchmark
+static uint64_t interpret(Neander *vm, Profile *prof) {
+    uint8_t *memory = vm->memory;
+    uint8_t AC = vm->AC;
+    int PC = vm->PC;
+    uint8_t N = vm->N, Z = vm->Z;
+    uint64_t steps = 0;
+    uint64_t budget = vm->jumps_left;
+
+    vm->stop = STOP_END;
+    while (PC < MEM_SIZE) {
+        uint8_t opcode = memory[PC];
+        uint8_t address = PC + 1 < MEM_SIZE ? memory[PC + 1] : 0;
+
+        // Interrompe antes de um desvio tomado quando o limite foi atingido
+        uint8_t op = opcode & 0xF0;
+        int taken = op == 0x80 || (op == 0x90 && N) || (op == 0xA0 && Z);
+        if (taken && budget-- == 0) {
+            vm->stop = STOP_LIMIT;
+            budget = 0;
+            break;
+        }
+        steps++;
+        if (prof) profile_step(prof, PC, op, address, taken);
+        
+        // Verifica se é instrução HLT
+        if ((opcode & 0xF0) == 0xF0) {
+            PC += 1;
+            vm->stop = STOP_HLT;
+            break;
+        }
+        else if ((opcode & 0xF0) == 0x60) { // Verifica se é NOT
+            PC += 1;
+        } 
+        else {  // Instruções de 2 bytes
+            PC += 2;
+        }
+        
+        // Executa a instrução com base no opcode
+        switch (opcode & 0xF0) {
+            case 0x10: memory[address] = AC; break;     // STA: armazena AC na memória
+            case 0x20: AC = memory[address]; break;     // LDA: carrega valor da memória para AC
+            case 0x30: AC += memory[address]; break;    // ADD: soma valor da memória ao AC
+            case 0x40: AC |= memory[address]; break;    // OR: AC |= memória
+            case 0x50: AC &= memory[address]; break;    // AND: AC &= memória
+            case 0x60: AC = ~AC; break;                 // NOT: inverte bits do AC
+            case 0x80: PC = address; break;             // JMP: desvia
+            case 0x90: if (N) PC = address; break;      // JN: desvia se negativo
+            case 0xA0: if (Z) PC = address; break;      // JZ: desvia se zero
+        }
+        
+        // Atualiza flags N e Z
+        N = (AC & 0x80) ? 1 : 0;
+        Z = (AC == 0) ? 1 : 0;
+    }
+
+    vm->AC = AC;
+    vm->PC = PC;
+    vm->N = N;
+    vm->Z = Z;
+    vm->jumps_left = budget;
+    return steps;
+}
+
+// Executa o programa com o interpretador de referência, sem perfil
+uint64_t neander_run_switch(Neander *vm) {
+    return interpret(vm, NULL);
+}
+
+// Interpretador do modo estendido: mesmas instruções e flags, com operandos de 16 bits
+// e o PC percorrendo os 64 KiB de memória. Bytes além do fim da memória valem zero
+void neander_ext_interpret(NeanderExt *vm) {
+    uint8_t AC = vm->AC;
+    uint32_t PC = vm->PC;
+    uint8_t N = vm->N, Z = vm->Z;
+    uint64_t budget = vm->jumps_left;
+
+    vm->stop = STOP_END;
+    while (PC < EXT_MEM_SIZE && !vm->failed) {
+        uint8_t opcode = ext_read(vm, PC);
+        uint32_t address = (PC + 1 < EXT_MEM_SIZE ? ext_read(vm, PC + 1) : 0) |
+                           (PC + 2 < EXT_MEM_SIZE ? ext_read(vm, PC + 2) << 8 : 0);
+
+        // Interrompe antes de um desvio tomado quando o limite foi atingido
+        uint8_t op = opcode & 0xF0;
+        int taken = op == 0x80 || (op == 0x90 && N) || (op == 0xA0 && Z);
+        if (taken && budget-- == 0) {
+            vm->stop = STOP_LIMIT;
+            budget = 0;
+            break;
+        }
+
+        if (op == 0xF0) {           // HLT
+            PC += 1;
+            vm->stop = STOP_HLT;
+            break;
+        }
+        PC += op == 0x60 ? 1 : 3;   // NOT tem 1 byte, as demais têm opcode + operando de 16 bits
+
+        switch (op) {
+            case 0x10:
+                if (ext_write(vm, address, AC) != 0) PC -= 3;   // Sem memória: para no STA (vm->failed)
+                break;
+            case 0x20: AC = ext_read(vm, address); break;
+            case 0x30: AC += ext_read(vm, address); break;
+            case 0x40: AC |= ext_read(vm, address); break;
+            case 0x50: AC &= ext_read(vm, address); break;
+            case 0x60: AC = ~AC; break;
+            case 0x80: PC = address; break;
+            case 0x90: if (N) PC = address; break;
+            case 0xA0: if (Z) PC = address; break;
+        }
+
+        N = (AC & 0x80) ? 1 : 0;
+        Z = (AC == 0) ? 1 : 0;
+    }
+
+    vm->AC = AC;
+    vm->PC = PC;
+    vm->N = N;
+    vm->Z = Z;
+    vm->jumps_left = budget;
+}
+
+#if defined(__GNUC__)
+
+// Tipos de instrução pré-decodificada. Cada um corresponde a um rótulo do laço de despacho
+enum {
+    K_NOP,      // Opcodes sem efeito (NOP e opcodes não usados), ocupam 2 bytes como no interpretador de referência
+    K_STA,      // STA em endereço de dados
+    K_STA_CODE, // STA em endereço que pertence ao código alcançável (código automodificável)
+    K_LDA, K_ADD, K_OR, K_AND, K_NOT,
+    K_JMP, K_JN, K_JZ,
+    K_HLT,
+    K_END,      // PC saiu da memória (PC >= MEM_SIZE)
+    K_IDIOM,    // Início de um laço reconhecido (ver Idiom)
+    K_UNDECODED,    // Entrada ainda não decodificada: é decodificada no primeiro despacho
+    K_LOOP,     // JMP para trás ainda não tomado: no primeiro desvio procura um laço conhecido no destino
+    K_COUNT
+};
+
+// Instrução pré-decodificada: existe uma entrada para cada endereço da memória, pois
+// um desvio pode cair em qualquer byte, mas só as entradas executadas são decodificadas.
+// As duas entradas extras representam PC = 256 e 257
+// O tamanho de cada instrução é fixo no rótulo (PC + 1 ou PC + 2), o que mantém o avanço
+// sequencial fora da cadeia de dependência de leituras da memória
+typedef struct Decoded {
+    const void *handler;            // Rótulo que executa a instrução (despacho por computed goto)
+    uint8_t *operand;               // Ponteiro já resolvido para memory[operando]
+    const struct Decoded *jump;     // Entrada de destino de JMP/JN/JZ
+    uint8_t target;                 // Endereço do operando (destino do desvio ou do STA)
+    uint8_t kind;
+} Decoded;
+
+#define IDIOM_MAX_GROUPS 8   // Máximo de grupos "LDA v / ADD w / STA v" em um laço de soma contada
+#define IDIOM_MAX 32         // Máximo de laços reconhecidos por imagem
+
+// Formatos de laço reconhecidos no destino dos desvios para trás
+enum {
+    IDIOM_MUL,      // Laço de somas repetidas gerado por termo() para "*"
+    IDIOM_COUNTED   // Laço de somas com incremento constante até um contador zerar (ex.: "/" de termo())
+};
+
+// Laço que pode ser substituído por um passo em forma fechada
+//
+// IDIOM_MUL (S = início, 25 bytes):          IDIOM_COUNTED (S = início):
+//   S: LDA B      JZ FIM                       S: LDA v0  ADD w0  STA v0   (um grupo por variável)
+//      LDA X      ADD TEMP  STA X                 ...
+//      LDA AUX2   ADD AUX1  STA AUX2              LDA c     (c é uma das variáveis v)
+//      NOT        ADD AUX1  ADD B                 JZ FIM
+//      JZ FIM     JMP S                           JMP S
+//
+// Na multiplicação var/inc guardam X/TEMP e AUX2/AUX1
+typedef struct {
+    uint8_t type;
+    uint8_t start;
+    uint8_t size;                   // Bytes ocupados pelo laço a partir de start
+    uint8_t exit;                   // Destino do JZ de saída
+    uint8_t counter;                // IDIOM_MUL: endereço de B; IDIOM_COUNTED: índice da variável testada
+    uint8_t groups;
+    uint8_t var[IDIOM_MAX_GROUPS];
+    uint8_t inc[IDIOM_MAX_GROUPS];
+    uint8_t original;               // Tipo da instrução em start, executada quando o passo não se aplica
+    uint8_t active;
+} Idiom;
+
+// Estado do motor pré-decodificado de uma execução
+typedef struct {
+    Decoded code[MEM_SIZE + 2];
+    uint8_t code_byte[MEM_SIZE];    // Bytes lidos por alguma entrada já decodificada
+    uint8_t stored[MEM_SIZE];       // Bytes escritos por algum STA já decodificado
+    uint8_t idiom_at[MEM_SIZE];     // Índice + 1 do laço reconhecido que começa no endereço
+    Idiom idioms[IDIOM_MAX];
+    int idiom_count;
+    int use_idioms;
+    uint8_t *memory;
+    const void *const *labels;
+} Engine;
+
+// Volta a entrada addr para o estado não decodificado (decodificada de novo no próximo despacho)
+static void invalidate_entry(Engine *e, int addr) {
+    e->code[addr].kind = K_UNDECODED;
+    e->code[addr].handler = e->labels[K_UNDECODED];
+    e->idiom_at[addr] = 0;
+}
+
+// Passa a tratar o byte addr como código. Os STA já decodificados que escrevem nele passam a invalidar
+// as entradas afetadas (só acontece em código automodificável)
+static void mark_code(Engine *e, int addr) {
+    if (addr >= MEM_SIZE || e->code_byte[addr]) return;
+    e->code_byte[addr] = 1;
+    if (!e->stored[addr]) return;
+    for (int i = 0; i < MEM_SIZE; i++) {
+        if (e->code[i].kind == K_STA && e->code[i].target == addr) {
+            e->code[i].kind = K_STA_CODE;
+            e->code[i].handler = e->labels[K_STA_CODE];
+        }
+    }
+}
+
+// Decodifica a entrada do endereço addr a partir dos bytes atuais da memória
+static void decode_entry(Engine *e, int addr) {
+    Decoded *d = &e->code[addr];
+    uint8_t opcode = e->memory[addr];
+    uint8_t operand = addr + 1 < MEM_SIZE ? e->memory[addr + 1] : 0;
+
+    d->operand = &e->memory[operand];
+    d->jump = &e->code[operand];
+    d->target = operand;
+    e->idiom_at[addr] = 0;
+
+    // Os dois bytes da entrada passam a ser código (antes da classificação, para um STA que escreve no próprio operando)
+    mark_code(e, addr);
+    mark_code(e, addr + 1);
+
+    switch (opcode & 0xF0) {
+        case 0x10:
+            d->kind = e->code_byte[operand] ? K_STA_CODE : K_STA;
+            e->stored[operand] = 1;
+            break;
+        case 0x20: d->kind = K_LDA; break;
+        case 0x30: d->kind = K_ADD; break;
+        case 0x40: d->kind = K_OR; break;
+        case 0x50: d->kind = K_AND; break;
+        case 0x60: d->kind = K_NOT; break;
+        case 0x80: d->kind = e->use_idioms && operand <= addr ? K_LOOP : K_JMP; break;
+        case 0x90: d->kind = K_JN; break;
+        case 0xA0: d->kind = K_JZ; break;
+        case 0xF0: d->kind = K_HLT; break;
+        default: d->kind = K_NOP; break;
+    }
+    d->handler = e->labels[d->kind];
+}
+
+static void code_written(Engine *e, int addr);
+
+// Verifica se a instrução em addr tem o opcode op; se tiver, devolve o operando em *operand
+static int match_insn(const uint8_t *memory, int addr, uint8_t op, uint8_t *operand) {
+    if (addr + 1 >= MEM_SIZE || (memory[addr] & 0xF0) != op) return 0;
+    *operand = memory[addr + 1];
+    return 1;
+}
+
+// Verifica se as células usadas pelo laço são distintas e ficam fora dos bytes do próprio laço
+static int idiom_cells_ok(const Idiom *id, const uint8_t *cells, int count) {
+    for (int i = 0; i < count; i++) {
+        if (cells[i] >= id->start && cells[i] < id->start + id->size) return 0;
+        for (int k = 0; k < i; k++) {
+            if (cells[i] == cells[k]) return 0;
+        }
+    }
+    return !(id->exit >= id->start && id->exit < id->start + id->size);
+}
+
+// Reconhece o laço de multiplicação que começa em s
+static int match_mul(const uint8_t *memory, int s, Idiom *id) {
+    uint8_t b, fim, x, temp, x2, aux2, aux1, aux2b, aux1b, b2, fim2, back;
+
+    if (s + 25 > MEM_SIZE) return 0;
+    if (!match_insn(memory, s, 0x20, &b) || !match_insn(memory, s + 2, 0xA0, &fim) ||
+        !match_insn(memory, s + 4, 0x20, &x) || !match_insn(memory, s + 6, 0x30, &temp) ||
+        !match_insn(memory, s + 8, 0x10, &x2) || !match_insn(memory, s + 10, 0x20, &aux2) ||
+        !match_insn(memory, s + 12, 0x30, &aux1) || !match_insn(memory, s + 14, 0x10, &aux2b) ||
+        (memory[s + 16] & 0xF0) != 0x60 || !match_insn(memory, s + 17, 0x30, &aux1b) ||
+        !match_insn(memory, s + 19, 0x30, &b2) || !match_insn(memory, s + 21, 0xA0, &fim2) ||
+        !match_insn(memory, s + 23, 0x80, &back)) {
+        return 0;
+    }
+    if (x2 != x || aux2b != aux2 || aux1b != aux1 || b2 != b || fim2 != fim || back != s) return 0;
+
+    id->type = IDIOM_MUL;
+    id->start = s;
+    id->size = 25;
+    id->exit = fim;
+    id->counter = b;
+    id->groups = 2;
+    id->var[0] = x; id->inc[0] = temp;
+    id->var[1] = aux2; id->inc[1] = aux1;
+
+    uint8_t cells[] = {b, x, temp, aux2, aux1};
+    return idiom_cells_ok(id, cells, 5);
+}
+
+// Reconhece um laço de soma contada que começa em s
+static int match_counted(const uint8_t *memory, int s, Idiom *id) {
+    uint8_t v, w, v2, c, fim, back;
+    uint8_t cells[2 * IDIOM_MAX_GROUPS];
+    int at = s, groups = 0, counter = -1;
+
+    while (groups < IDIOM_MAX_GROUPS && match_insn(memory, at, 0x20, &v) &&
+           match_insn(memory, at + 2, 0x30, &w) && match_insn(memory, at + 4, 0x10, &v2) && v2 == v) {
+        id->var[groups] = v;
+        id->inc[groups] = w;
+        groups++;
+        at += 6;
+    }
+    if (groups == 0 || !match_insn(memory, at, 0x20, &c) || !match_insn(memory, at + 2, 0xA0, &fim) ||
+        !match_insn(memory, at + 4, 0x80, &back) || back != s) {
+        return 0;
+    }
+
+    // As variáveis precisam ser distintas e os incrementos não podem ser alterados pelo laço
+    for (int i = 0; i < groups; i++) {
+        if (id->var[i] == c) counter = i;
+        for (int k = 0; k < groups; k++) {
+            if (id->inc[i] == id->var[k]) return 0;
+        }
+        cells[i] = id->var[i];
+    }
+    if (counter < 0) return 0;
+
+    id->type = IDIOM_COUNTED;
+    id->start = s;
+    id->size = at + 6 - s;
+    id->exit = fim;
+    id->counter = counter;
+    id->groups = groups;
+
+    // Os incrementos podem se repetir entre si, então só as variáveis precisam ser distintas
+    if (!idiom_cells_ok(id, cells, groups)) return 0;
+    for (int i = 0; i < groups; i++) {
+        if (id->inc[i] >= s && id->inc[i] < s + id->size) return 0;
+    }
+    return 1;
+}
+
+// Procura um laço conhecido que começa em s (destino de um desvio para trás) e instala o passo em forma fechada
+static void find_idiom(Engine *e, int s) {
+    if (e->idiom_count == IDIOM_MAX || e->idiom_at[s]) return;
+
+    Idiom *id = &e->idioms[e->idiom_count];
+    if (!match_mul(e->memory, s, id) && !match_counted(e->memory, s, id)) return;
+
+    // Escritas em qualquer byte do laço precisam desfazer a substituição (ver code_written)
+    for (int i = s; i < s + id->size; i++) mark_code(e, i);
+    if (e->code[s].kind == K_UNDECODED) decode_entry(e, s);
+
+    id->original = e->code[s].kind;
+    id->active = 1;
+    e->code[s].kind = K_IDIOM;
+    e->code[s].handler = e->labels[K_IDIOM];
+    e->idiom_at[s] = ++e->idiom_count;
+}
+
+// Calcula quantas iterações o laço executará a partir da memória atual
+// Retorna 0 quando o passo não se aplica (multiplicador zero, AUX1 diferente de 1 ou laço infinito)
+static uint32_t idiom_trip_count(const Idiom *id, const uint8_t *memory) {
+    if (id->type == IDIOM_MUL) {
+        // X += TEMP e AUX2 += 1 até AUX2 chegar em B (AC = ~AUX2 + AUX1 + B = B - AUX2)
+        uint8_t b = memory[id->counter];
+        if (b == 0 || memory[id->inc[1]] != 1) return 0;
+        uint8_t n = b - memory[id->var[1]];
+        return n ? n : 256;
+    }
+
+    // Menor n >= 1 com c + n * d = 0 (mod 256): n * d' = r (mod 256 / g), com g = mdc(d, 256)
+    uint8_t c = memory[id->var[id->counter]];
+    uint8_t d = memory[id->inc[id->counter]];
+    uint8_t minus_c = -c;
+    if (d == 0) return c == 0 ? 1 : 0;
+
+    unsigned g = d & -d;
+    if (minus_c % g != 0) return 0;
+    unsigned modulus = 256 / g;
+    uint8_t odd = d / g, inverse = odd;
+    for (int i = 0; i < 3; i++) inverse *= 2 - odd * inverse;   // Inverso de odd mod 256 (Newton)
+    unsigned n = ((minus_c / g) * inverse) % modulus;
+    return n ? n : modulus;
+}
+
+// Aplica n iterações do laço de uma vez
+static void idiom_apply(Engine *e, const Idiom *id, uint32_t n) {
+    for (int i = 0; i < id->groups; i++) {
+        e->memory[id->var[i]] += (uint8_t)(n * e->memory[id->inc[i]]);
+    }
+    // Uma variável do laço pode ser byte de outro trecho de código alcançável
+    for (int i = 0; i < id->groups; i++) {
+        if (e->code_byte[id->var[i]]) code_written(e, id->var[i]);
+    }
+}
+
+// Prepara o motor para uma execução: nenhuma entrada é decodificada antes de ser executada, então
+// programas curtos não pagam pela decodificação da memória inteira
+static void engine_init(Engine *e, uint8_t *memory, const void *const *labels, int use_idioms) {
+    e->memory = memory;
+    e->labels = labels;
+    e->use_idioms = use_idioms;
+    e->idiom_count = 0;
+    memset(e->code_byte, 0, sizeof(e->code_byte));
+    memset(e->stored, 0, sizeof(e->stored));
+    memset(e->idiom_at, 0, sizeof(e->idiom_at));
+
+    for (int i = 0; i < MEM_SIZE; i++) {
+        e->code[i].kind = K_UNDECODED;
+        e->code[i].handler = labels[K_UNDECODED];
+    }
+    for (int i = MEM_SIZE; i < MEM_SIZE + 2; i++) {
+        e->code[i].kind = K_END;
+        e->code[i].handler = labels[K_END];
+    }
+}
+
+// Invalida as entradas afetadas por uma escrita no código (decodificadas de novo no próximo despacho)
+static void code_written(Engine *e, int addr) {
+    // Laços reconhecidos que contêm o byte alterado voltam a ser executados instrução a instrução
+    for (int i = 0; i < e->idiom_count; i++) {
+        Idiom *id = &e->idioms[i];
+        if (id->active && addr + 1 >= id->start && addr < id->start + id->size) {
+            id->active = 0;
+            invalidate_entry(e, id->start);
+        }
+    }
+
+    for (int i = addr - 1; i <= addr; i++) {
+        if (i >= 0) invalidate_entry(e, i);
+    }
+}
+
+// Executa o programa com o motor pré-decodificado e despacho por computed goto
+// As flags N e Z são calculadas a partir do AC somente quando JN/JZ precisam delas
+// A execução continua a partir do estado atual da instância (AC, PC, N e Z)
+static void run_threaded(Neander *vm) {
+    static const void *const labels[K_COUNT] = {
+        [K_NOP] = &&op_nop, [K_STA] = &&op_sta, [K_STA_CODE] = &&op_sta_code,
+        [K_LDA] = &&op_lda, [K_ADD] = &&op_add, [K_OR] = &&op_or, [K_AND] = &&op_and,
+        [K_NOT] = &&op_not, [K_JMP] = &&op_jmp, [K_JN] = &&op_jn, [K_JZ] = &&op_jz,
+        [K_HLT] = &&op_hlt, [K_END] = &&op_end, [K_IDIOM] = &&op_idiom, [K_UNDECODED] = &&op_undecoded,
+        [K_LOOP] = &&op_loop
+    };
+    Engine engine;
+    Engine *e = &engine;
+    const Decoded *ip;
+    uint8_t AC = vm->AC;
+    uint64_t budget = vm->jumps_left;
+
+    vm->stop = STOP_END;
+    if (vm->PC >= MEM_SIZE) return;
+
+    engine_init(e, vm->memory, labels, vm->use_idioms);
+    decode_entry(e, vm->PC);
+    ip = e->code + vm->PC;
+
+    // As flags só podem diferir de f(AC) antes da primeira instrução (N = Z = 0 com AC = 0),
+    // então a primeira instrução usa as flags da instância, como no interpretador de referência
+    if (ip->kind == K_HLT) {
+        vm->PC += 1;
+        vm->stop = STOP_HLT;
+        return;
+    }
+    if ((ip->kind == K_JN && vm->N) || (ip->kind == K_JZ && vm->Z)) {
+        if (budget-- == 0) goto out_of_jumps;
+        ip = ip->jump;
+    } else if (ip->kind == K_JN || ip->kind == K_JZ) {
+        ip += 2;
+    }
+
+#define DISPATCH() goto *ip->handler
+#define NEXT() do { ip += 2; DISPATCH(); } while (0)
+
+    DISPATCH();
+
+op_nop:
+    NEXT();
+op_sta:
+    *ip->operand = AC;
+    NEXT();
+op_sta_code:
+    if (*ip->operand != AC) {
+        *ip->operand = AC;
+        code_written(e, ip->target);
+    }
+    NEXT();
+op_lda:
+    AC = *ip->operand;
+    NEXT();
+op_add:
+    AC += *ip->operand;
+    NEXT();
+op_or:
+    AC |= *ip->operand;
+    NEXT();
+op_and:
+    AC &= *ip->operand;
+    NEXT();
+op_not:
+    AC = ~AC;
+    ip += 1;
+    DISPATCH();
+op_jmp:
+    if (budget-- == 0) goto out_of_jumps;
+    ip = ip->jump;
+    DISPATCH();
+op_loop:
+    // Só o primeiro desvio de cada JMP para trás procura o laço; depois a entrada é um JMP comum
+    find_idiom(e, ip->target);
+    e->code[ip - e->code].kind = K_JMP;
+    e->code[ip - e->code].handler = labels[K_JMP];
+    goto op_jmp;
+op_undecoded:
+    decode_entry(e, ip - e->code);
+    DISPATCH();
+op_jn:
+    if (!(AC & 0x80)) NEXT();
+    if (budget-- == 0) goto out_of_jumps;
+    ip = ip->jump;
+    DISPATCH();
+op_jz:
+    if (AC != 0) NEXT();
+    if (budget-- == 0) goto out_of_jumps;
+    ip = ip->jump;
+    DISPATCH();
+op_idiom: {
+        const Idiom *id = &e->idioms[e->idiom_at[ip - e->code] - 1];
+        uint32_t n = idiom_trip_count(id, vm->memory);
+        // Cada iteração toma um desvio (JMP de volta ou o JZ de saída)
+        if (n == 0 || n > budget) goto *labels[id->original];
+        budget -= n;
+        idiom_apply(e, id, n);
+        vm->idioms_applied++;
+        vm->iterations_skipped += n;
+        AC = 0;
+        ip = e->code + id->exit;
+        DISPATCH();
+    }
+op_hlt:
+    ip += 1;
+    vm->stop = STOP_HLT;
+    goto done;
+out_of_jumps:
+    vm->stop = STOP_LIMIT;
+    budget = 0;
+op_end:
+done:
+
+#undef NEXT
+#undef DISPATCH
+
+    vm->AC = AC;
+    vm->PC = ip - e->code;
+    vm->N = (AC & 0x80) ? 1 : 0;
+    vm->Z = (AC == 0) ? 1 : 0;
+    vm->jumps_left = budget;
+    if (vm->use_idioms) vm->idioms_found = e->idiom_count;
+}
+
+#else
+
+// Sem computed goto (compiladores que não são GCC/Clang) o interpretador de referência é usado
+static void run_threaded(Neander *vm) {
+    neander_run_switch(vm);
+}
+
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && defined(MAP_ANONYMOUS)
+
+#define JIT_BUFFER_SIZE (1 << 20)   // Tamanho do buffer de código nativo (1 MiB)
+#define JIT_MAX_BLOCK 128           // Máximo de instruções Neander por bloco traduzido
+#define JIT_MAX_INSN_BYTES 48       // Maior tradução de uma instrução (JZ/JN com stubs de saída)
+
+// Bits de estado combinados com o PC de saída de um bloco
+#define JIT_EXIT_HALT 0x10000       // HLT executado
+#define JIT_EXIT_LIMIT 0x20000      // Limite de desvios atingido (PC aponta para o desvio)
+#define JIT_EXIT_FALLBACK 0x40000   // Escrita em código: continuar no interpretador a partir do PC
+
+// Estado trocado entre o código nativo e o despachante em C
+// Convenção dentro do código gerado: rdi = base da memória, dl = AC, rcx = desvios restantes, rsi = JitExit
+typedef struct {
+    uint64_t budget;
+    uint8_t *site;      // Stub de saída encadeável que devolveu o controle (NULL se não encadeável)
+    uint32_t pc;
+    uint8_t ac;
+} JitExit;
+
+typedef void (*JitEnter)(uint8_t *memory, JitExit *exit, const uint8_t *code, uint64_t budget);
+
+// Cache de tradução de uma thread. Os blocos são indexados pelo PC de entrada
+typedef struct {
+    uint8_t *buffer;
+    size_t used;
+    uint8_t *cache[MEM_SIZE];
+    uint8_t covered[MEM_SIZE];  // Bytes lidos por algum bloco traduzido
+    uint8_t written[MEM_SIZE];  // Endereços escritos por algum STA traduzido
+    uint8_t source[MEM_SIZE];   // Valor dos bytes cobertos no momento da tradução
+    uint8_t *common_exit;
+    JitEnter enter;
+    uint8_t *emit;              // Posição de escrita durante a tradução
+    int writable;               // Buffer em RW (tradução) ou RX (execução), nunca os dois
+} Jit;
+
+static __thread Jit *thread_jit;
+static pthread_key_t jit_key;   // Libera o cache de tradução quando a thread termina
+static pthread_once_t jit_key_once = PTHREAD_ONCE_INIT;
+
+// Alterna o buffer entre escrita (RW) e execução (RX). Retorna 0, ou -1 se o sistema recusar
+static int jit_protect(Jit *j, int writable) {
+    if (j->writable == writable) return 0;
+    if (mprotect(j->buffer, JIT_BUFFER_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0) return -1;
+    j->writable = writable;
+    return 0;
+}
+
+static void jit_destroy(void *p) {
+    Jit *j = p;
+    munmap(j->buffer, JIT_BUFFER_SIZE);
+    free(j);
+}
+
+static void jit_key_create(void) {
+    pthread_key_create(&jit_key, jit_destroy);
+}
+
+static void emit8(Jit *j, uint8_t byte) {
+    *j->emit++ = byte;
+}
+
+static void emit32(Jit *j, uint32_t value) {
+    memcpy(j->emit, &value, 4);
+    j->emit += 4;
+}
+
+// Emite "jmp rel32" para o destino
+static void emit_jmp(Jit *j, const uint8_t *target) {
+    emit8(j, 0xE9);
+    emit32(j, (uint32_t)(target - (j->emit + 4)));
+}
+
+// Emite uma instrução "op reg8, [rdi + endereço]" com dl como registrador
+static void emit_mem_op(Jit *j, uint8_t opcode, uint8_t address) {
+    emit8(j, opcode);
+    emit8(j, 0x97);
+    emit32(j, address);
+}
+
+// Saída não encadeável: devolve o PC com os bits de estado ao despachante
+static void emit_exit(Jit *j, uint32_t pc_and_state) {
+    emit8(j, 0xB8); emit32(j, pc_and_state);        // mov eax, pc
+    emit8(j, 0x45); emit8(j, 0x31); emit8(j, 0xC9); // xor r9d, r9d
+    emit_jmp(j, j->common_exit);
+}
+
+// Saída encadeável para o bloco de PC pc. O primeiro jmp começa apontando para a instrução
+// seguinte e é corrigido para o bloco de destino quando este for traduzido
+static void emit_chain_exit(Jit *j, uint32_t pc) {
+    uint8_t *site = j->emit;
+    emit8(j, 0xE9); emit32(j, 0);                   // jmp (ponto de encadeamento)
+    emit8(j, 0xB8); emit32(j, pc);                  // mov eax, pc
+    emit8(j, 0x4C); emit8(j, 0x8D); emit8(j, 0x0D); // lea r9, [rip - 17] (início do stub)
+    emit32(j, (uint32_t)(site - (j->emit + 4)));
+    emit_jmp(j, j->common_exit);
+}
+
+// Desvio tomado: consome um desvio do orçamento e sai para o bloco de destino
+static void emit_taken_jump(Jit *j, uint8_t jump_pc, uint8_t target) {
+    emit8(j, 0x48); emit8(j, 0x85); emit8(j, 0xC9); // test rcx, rcx
+    emit8(j, 0x74); emit8(j, 3 + 22);               // jz limite
+    emit8(j, 0x48); emit8(j, 0xFF); emit8(j, 0xC9); // dec rcx
+    emit_chain_exit(j, target);
+    emit_exit(j, jump_pc | JIT_EXIT_LIMIT);
+}
+
+// Descarta todas as traduções (buffer cheio ou nova execução)
+static void jit_flush(Jit *j) {
+    jit_protect(j, 1);
+    memset(j->cache, 0, sizeof(j->cache));
+    memset(j->covered, 0, sizeof(j->covered));
+    memset(j->written, 0, sizeof(j->written));
+
+    // Trampolim de entrada e rotina comum de saída ficam no início do buffer
+    j->emit = j->buffer;
+    j->enter = (JitEnter)j->emit;
+    emit8(j, 0x48); emit8(j, 0x89); emit8(j, 0xD0);                 // mov rax, rdx
+    emit8(j, 0x0F); emit8(j, 0xB6); emit8(j, 0x56); emit8(j, offsetof(JitExit, ac));   // movzx edx, byte [rsi + ac]
+    emit8(j, 0xFF); emit8(j, 0xE0);                                 // jmp rax
+
+    j->common_exit = j->emit;
+    emit8(j, 0x88); emit8(j, 0x56); emit8(j, offsetof(JitExit, ac));                   // mov [rsi + ac], dl
+    emit8(j, 0x89); emit8(j, 0x46); emit8(j, offsetof(JitExit, pc));                   // mov [rsi + pc], eax
+    emit8(j, 0x48); emit8(j, 0x89); emit8(j, 0x4E); emit8(j, offsetof(JitExit, budget)); // mov [rsi + budget], rcx
+    emit8(j, 0x4C); emit8(j, 0x89); emit8(j, 0x4E); emit8(j, offsetof(JitExit, site));   // mov [rsi + site], r9
+    emit8(j, 0xC3);                                                                     // ret
+    j->used = j->emit - j->buffer;
+}
+
+// Verifica se as traduções existentes ainda correspondem à imagem em memória,
+// o que permite reaproveitá-las ao executar a mesma imagem várias vezes
+static int jit_matches(const Jit *j, const uint8_t *memory) {
+    for (int i = 0; i < MEM_SIZE; i++) {
+        if (j->covered[i] && j->source[i] != memory[i]) return 0;
+    }
+    return 1;
+}
+
+// Retorna o cache de tradução da thread atual, criando-o na primeira chamada (liberado por
+// jit_destroy quando a thread termina). Retorna NULL se o sistema não permitir memória executável
+static Jit *jit_get(void) {
+    if (thread_jit) return thread_jit;
+
+    int failed = 0;
+    Jit *j = neander_alloc(NULL, 1, sizeof(Jit), &failed);
+    if (!j) return NULL;
+    memset(j, 0, sizeof(Jit));
+    j->buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (j->buffer == MAP_FAILED) {
+        free(j);
+        return NULL;
+    }
+    j->writable = 1;
+    jit_flush(j);
+    if (jit_protect(j, 0) != 0) {
+        jit_destroy(j);
+        return NULL;
+    }
+    pthread_once(&jit_key_once, jit_key_create);
+    pthread_setspecific(jit_key, j);
+    thread_jit = j;
+    return j;
+}
+
+// Traduz o bloco que começa em pc. Retorna NULL quando o bloco contém bytes que algum STA
+// já traduzido pode alterar; nesse caso a execução continua no interpretador
+static uint8_t *jit_translate(Jit *j, const uint8_t *memory, int pc) {
+    int insn_pc[JIT_MAX_BLOCK];
+    jit_protect(j, 1);
+    int count = 0, end = pc;
+    int known_cell = -1;    // Endereço cujo valor já está em AC (evita LDA redundante após STA/LDA)
+
+    // Delimita o bloco: termina em JMP, HLT, fim da memória ou no tamanho máximo
+    while (end < MEM_SIZE && count < JIT_MAX_BLOCK) {
+        uint8_t op = memory[end] & 0xF0;
+        insn_pc[count++] = end;
+        if (op == 0x80 || op == 0xF0) break;
+        end += (op == 0x60) ? 1 : 2;
+    }
+
+    // O bloco é truncado antes do primeiro STA que escreve em código traduzido ou no próprio bloco
+    for (int i = 0; i < count; i++) {
+        int at = insn_pc[i];
+        if (j->written[at] || (at + 1 < MEM_SIZE && j->written[at + 1])) {
+            if (i == 0) return NULL;
+            count = i;
+            break;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        for (int at = insn_pc[i]; at <= insn_pc[i] + 1 && at < MEM_SIZE; at++) {
+            j->covered[at] = 1;
+            j->source[at] = memory[at];
+        }
+    }
+
+    if (j->used + (count + 2) * JIT_MAX_INSN_BYTES > JIT_BUFFER_SIZE) {
+        jit_flush(j);
+        return jit_translate(j, memory, pc);
+    }
+
+    j->emit = j->buffer + j->used;
+    uint8_t *block = j->emit;
+    int next = pc;
+
+    for (int i = 0; i < count; i++) {
+        int at = insn_pc[i];
+        uint8_t op = memory[at] & 0xF0;
+        uint8_t address = at + 1 < MEM_SIZE ? memory[at + 1] : 0;
+        next = at + ((op == 0x60 || op == 0xF0) ? 1 : 2);
+
+        switch (op) {
+            case 0x10:  // STA
+                if (j->covered[address]) {
+                    emit_exit(j, at | JIT_EXIT_FALLBACK);
+                    goto finished;
+                }
+                j->written[address] = 1;
+                emit_mem_op(j, 0x88, address);  // mov [rdi + a], dl
+                known_cell = address;
+                break;
+            case 0x20:  // LDA
+                if (known_cell != address) emit_mem_op(j, 0x8A, address);   // mov dl, [rdi + a]
+                known_cell = address;
+                break;
+            case 0x30: emit_mem_op(j, 0x02, address); known_cell = -1; break;  // add dl, [rdi + a]
+            case 0x40: emit_mem_op(j, 0x0A, address); known_cell = -1; break;  // or dl, [rdi + a]
+            case 0x50: emit_mem_op(j, 0x22, address); known_cell = -1; break;  // and dl, [rdi + a]
+            case 0x60: emit8(j, 0xF6); emit8(j, 0xD2); known_cell = -1; break; // not dl
+            case 0x80:  // JMP
+                emit_taken_jump(j, at, address);
+                goto finished;
+            case 0x90:  // JN
+            case 0xA0:  // JZ
+                emit8(j, 0x84); emit8(j, 0xD2);                     // test dl, dl
+                emit8(j, op == 0x90 ? 0x79 : 0x75);                 // jns/jnz (desvio não tomado)
+                emit8(j, 3 + 2 + 3 + 22 + 13);
+                emit_taken_jump(j, at, address);
+                break;
+            case 0xF0:  // HLT
+                emit_exit(j, next | JIT_EXIT_HALT);
+                goto finished;
+            default:    // NOP e opcodes sem efeito
+                break;
+        }
+    }
+    // Bloco terminou pelo tamanho máximo ou no fim da memória: segue para a próxima instrução
+    emit_chain_exit(j, next);
+
+finished:
+    j->used = j->emit - j->buffer;
+    j->cache[pc] = block;
+    return block;
+}
+
+// Executa o programa traduzindo blocos básicos para x86-64 sob demanda
+// Blocos traduzidos são encadeados diretamente; escritas em código continuam no interpretador
+static void run_jit(Neander *vm) {
+    Jit *j = jit_get();
+    JitExit state;
+    uint8_t *site = NULL;
+    uint64_t budget = vm->jumps_left;
+    int pc = vm->PC;
+
+    if (!j) {
+        run_threaded(vm);
+        return;
+    }
+    if (!jit_matches(j, vm->memory)) jit_flush(j);
+    vm->stop = STOP_END;
+
+    // A primeira instrução usa as flags da instância, que só podem diferir de f(AC) no início
+    if (pc < MEM_SIZE) {
+        uint8_t op = vm->memory[pc] & 0xF0;
+        if (op == 0xF0) {
+            vm->PC = pc + 1;
+            vm->stop = STOP_HLT;
+            return;
+        }
+        if (op == 0x90 || op == 0xA0) {
+            if ((op == 0x90 && vm->N) || (op == 0xA0 && vm->Z)) {
+                if (vm->jumps_left == 0) {
+                    vm->stop = STOP_LIMIT;
+                    return;
+                }
+                budget = --vm->jumps_left;
+                pc = pc + 1 < MEM_SIZE ? vm->memory[pc + 1] : 0;
+            } else {
+                pc += 2;
+            }
+            vm->N = (vm->AC & 0x80) ? 1 : 0;
+            vm->Z = (vm->AC == 0) ? 1 : 0;
+        }
+    }
+
+    state.ac = vm->AC;
+    while (pc < MEM_SIZE) {
+        uint8_t *code = j->cache[pc];
+        if (!code) {
+            size_t before = j->used;
+            code = jit_translate(j, vm->memory, pc);
+            if (!code) {
+                state.pc = pc | JIT_EXIT_FALLBACK;
+                break;
+            }
+            // Um flush durante a tradução invalida o stub que pediu este bloco
+            if (j->used < before) site = NULL;
+        }
+        if (site) {
+            uint32_t rel = (uint32_t)(code - (site + 5));
+            jit_protect(j, 1);
+            memcpy(site + 1, &rel, 4);
+        }
+
+        if (jit_protect(j, 0) != 0) {
+            state.pc = pc | JIT_EXIT_FALLBACK;
+            break;
+        }
+        j->enter(vm->memory, &state, code, budget);
+        budget = state.budget;
+        site = state.site;
+        pc = state.pc & 0xFFFF;
+        if (state.pc & (JIT_EXIT_HALT | JIT_EXIT_LIMIT | JIT_EXIT_FALLBACK)) break;
+    }
+
+    vm->AC = state.ac;
+    vm->PC = pc;
+    vm->N = (vm->AC & 0x80) ? 1 : 0;
+    vm->Z = (vm->AC == 0) ? 1 : 0;
+
+    if (state.pc & JIT_EXIT_HALT) {
+        vm->stop = STOP_HLT;
+    } else if (state.pc & JIT_EXIT_LIMIT) {
+        vm->stop = STOP_LIMIT;
+    }
+    vm->jumps_left = budget;
+
+    // Escrita em código: continua no interpretador a partir do estado atual
+    if (state.pc & JIT_EXIT_FALLBACK) {
+        run_threaded(vm);
+    }
+}
+
+#else
+
+// Sem x86-64 ou sem mmap a tradução não está disponível e o motor pré-decodificado é usado
+static void run_jit(Neander *vm) {
+    run_threaded(vm);
+}
+
+#endif
+
+// Executa a instância com o motor escolhido
+void neander_run_engine(Neander *vm, EngineKind engine) {
+    switch (engine) {
+        case ENGINE_SWITCH: neander_run_switch(vm); break;
+        case ENGINE_JIT: run_jit(vm); break;
+        default: run_threaded(vm); break;
+    }
+}
+
+// Acrescenta ao relatório o início do formato detalhado (memória antes da execução)
+static void report_before(Report *r, const Neander *vm, OutputFormat format) {
+    if (format == OUTPUT_VERBOSE) {
+        report_str(r, "Memoria antes da execucao:\n");
+        report_memory(r, vm->memory);
+    }
+}
+
+// Acrescenta ao relatório o resultado da execução no formato escolhido.
+// before é a memória antes da execução, usada pelo formato de diferenças
+static void report_result(Report *r, const Neander *vm, EngineKind engine, const uint8_t *before, OutputFormat format) {
+    static const char *stop_names[] = {"HLT", "FIM", "LIMITE"};
+
+    switch (format) {
+        case OUTPUT_BINARY: {
+            uint8_t regs[] = {vm->AC, vm->PC & 0xFF, vm->PC >> 8, vm->N, vm->Z};
+            report_bytes(r, vm->memory, MEM_SIZE);
+            report_bytes(r, regs, sizeof(regs));
+            return;
+        }
+        case OUTPUT_DIFF:
+            report_str(r, "Reg\tAntes\tDepois\n");
+            for (int i = 0; i < MEM_SIZE; i++) {
+                if (vm->memory[i] == before[i]) continue;
+                report_hex(r, i);
+                report_str(r, "\t");
+                report_hex(r, before[i]);
+                report_str(r, "\t");
+                report_hex(r, vm->memory[i]);
+                report_str(r, "\n");
+            }
+            /* fallthrough */
+        case OUTPUT_SUMMARY:
+            report_printf(r, "%s\tAC=%02X\tPC=%02X\tN=%d\tZ=%d\n", stop_names[vm->stop], vm->AC, vm->PC, vm->N, vm->Z);
+            return;
+        case OUTPUT_VERBOSE:
+            break;
+    }
+
+    report_str(r, "\n---------------------------------------------");
+    report_str(r, "\n\nMemoria apos a execucao:\n");
+    report_memory(r, vm->memory);
+    report_printf(r, "\nFinal:\nAC: %02X\nPC: %02X\nN: %d\nZ: %d\n", vm->AC, vm->PC, vm->N, vm->Z);
+    if (vm->stop == STOP_LIMIT) {
+        report_str(r, "Execucao interrompida: limite de desvios atingido\n");
+    }
+    if (engine == ENGINE_THREADED) {
+        if (vm->use_idioms) {
+            report_printf(r, "Idiomas: %u lacos reconhecidos, %llu substituicoes, %llu iteracoes evitadas\n", vm->idioms_found,
+                          (unsigned long long)vm->idioms_applied, (unsigned long long)vm->iterations_skipped);
+        } else {
+            report_str(r, "Idiomas: desativados\n");
+        }
+    }
+}
+
+// Executa o código carregado na memória simulada do Neander e escreve o relatório com um único write.
+// Quando prof não é NULL, a execução usa o interpretador de referência e registra o perfil
+NeanderResult neander_execute(Neander *vm, EngineKind engine, OutputFormat format, Profile *prof, NeanderBuffer *out) {
+    Report report, *r = &report;
+    uint8_t before[MEM_SIZE];
+
+    report_init(r, out);
+    memcpy(before, vm->memory, MEM_SIZE);
+
+    report_before(r, vm, format);
+    if (prof) {
+        interpret(vm, prof);
+        engine = ENGINE_SWITCH;
+    } else {
+        neander_run_engine(vm, engine);
+    }
+    report_result(r, vm, engine, before, format);
+    return report_flush(r);
+}
+
+// Acrescenta ao relatório os bytes diferentes de zero da memória estendida (só as páginas alocadas)
+static void report_ext_memory(Report *r, const NeanderExt *vm) {
+    report_str(r, "End\tValor\n");
+    for (int p = 0; p < EXT_PAGES; p++) {
+        if (vm->pages[p] == ext_zero_page) continue;
+        for (int i = 0; i < EXT_PAGE_SIZE; i++) {
+            if (vm->pages[p][i] == 0) continue;
+            report_hex(r, p);
+            report_hex(r, i);
+            report_str(r, "\t");
+            report_hex(r, vm->pages[p][i]);
+            report_str(r, "\n");
+        }
+    }
+}
+
+// Acrescenta ao relatório o resultado de uma execução do modo estendido (before: cópia da imagem carregada)
+static void report_ext_result(Report *r, const NeanderExt *vm, const NeanderExt *before, OutputFormat format) {
+    static const char *stop_names[] = {"HLT", "FIM", "LIMITE"};
+
+    switch (format) {
+        case OUTPUT_BINARY: {
+            uint8_t regs[] = {vm->AC, vm->PC & 0xFF, (vm->PC >> 8) & 0xFF, (vm->PC >> 16) & 0xFF, vm->PC >> 24, vm->N, vm->Z};
+            for (int p = 0; p < EXT_PAGES; p++) {
+                report_bytes(r, vm->pages[p], EXT_PAGE_SIZE);
+            }
+            report_bytes(r, regs, sizeof(regs));
+            return;
+        }
+        case OUTPUT_DIFF:
+            report_str(r, "End\tAntes\tDepois\n");
+            for (int p = 0; p < EXT_PAGES; p++) {
+                if (vm->pages[p] == before->pages[p]) continue;     // Página nunca escrita nas duas
+                for (int i = 0; i < EXT_PAGE_SIZE; i++) {
+                    if (vm->pages[p][i] == before->pages[p][i]) continue;
+                    report_hex(r, p);
+                    report_hex(r, i);
+                    report_str(r, "\t");
+                    report_hex(r, before->pages[p][i]);
+                    report_str(r, "\t");
+                    report_hex(r, vm->pages[p][i]);
+                    report_str(r, "\n");
+                }
+            }
+            /* fallthrough */
+        case OUTPUT_SUMMARY:
+            report_printf(r, "%s\tAC=%02X\tPC=%04X\tN=%d\tZ=%d\n", stop_names[vm->stop], vm->AC, vm->PC, vm->N, vm->Z);
+            return;
+        case OUTPUT_VERBOSE:
+            break;
+    }
+
+    report_str(r, "\n---------------------------------------------");
+    report_str(r, "\n\nMemoria apos a execucao (bytes diferentes de zero):\n");
+    report_ext_memory(r, vm);
+    report_printf(r, "\nFinal:\nAC: %02X\nPC: %04X\nN: %d\nZ: %d\n", vm->AC, vm->PC, vm->N, vm->Z);
+    if (vm->stop == STOP_LIMIT) {
+        report_str(r, "Execucao interrompida: limite de desvios atingido\n");
+    }
+    report_printf(r, "Paginas alocadas: %d de %d (%d bytes cada)\n", vm->pages_used, EXT_PAGES, EXT_PAGE_SIZE);
+}
+
+// Copia as páginas alocadas de uma instância do modo estendido (usada como "antes" no formato diff)
+static void ext_copy(NeanderExt *dst, const NeanderExt *src) {
+    neander_ext_init(dst);
+    for (int p = 0; p < EXT_PAGES; p++) {
+        if (src->pages[p] == ext_zero_page) continue;
+        store_ext(dst, p * EXT_PAGE_SIZE, src->pages[p], EXT_PAGE_SIZE);
+    }
+}
+
+// Executa uma instância do modo estendido, já carregada, e escreve o relatório
+NeanderResult neander_execute_ext(NeanderExt *vm, OutputFormat format, NeanderBuffer *out) {
+    int failed = 0;
+    NeanderExt *before = neander_alloc(NULL, 1, sizeof(NeanderExt), &failed);
+    Report report, *r = &report;
+    if (!before) return NEANDER_NO_MEMORY;
+    neander_ext_init(before);
+    report_init(r, out);
+
+    if (format == OUTPUT_VERBOSE) {
+        report_str(r, "Memoria antes da execucao (modo estendido, bytes diferentes de zero):\n");
+        report_ext_memory(r, vm);
+    }
+    if (format == OUTPUT_DIFF) ext_copy(before, vm);
+
+    neander_ext_interpret(vm);
+    if (vm->failed || before->failed) {
+        report_target(r)->failed = 1;   // Sem memória para uma página: o relatório não é escrito
+    } else {
+        report_ext_result(r, vm, before, format);
+    }
+    NeanderResult result = report_flush(r);
+
+    neander_ext_free(before);
+    free(before);
+    return result;
+}
@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "neander.h"
+
+// Superotimizador: para cada padrão de expressão, procura a menor sequência de instruções do Neander
+// sem desvios (LDA, ADD, OR, AND e NOT, com STA em uma temporária) que deixa o valor no AC, e grava as
+// encontradas no banco que o compilador consulta (compilador --superopt superopt.db).
+//
+// A busca é exaustiva em ordem de tamanho (bytes): a partir do estado inicial, cada instrução gera um
+// estado novo (AC e temporária em um conjunto de amostras de entrada), e estados repetidos são
+// descartados. O primeiro estado cujo AC coincide com o padrão nas amostras é conferido com todas as
+// entradas de 8 bits (256 com uma folha, 65536 com duas, 16777216 com três) antes de entrar no banco.
+//
+// Padrões procurados:
+//   - com só variáveis: uma operação (+ - * / %) entre duas folhas, e duas operações (+ -) entre três,
+//     com folhas repetidas ou não;
+//   - com um valor conhecido k (0 a 255): x*k, x/k e x%k. As constantes da busca são derivadas de k
+//     (x-k e k-x já saem do compilador como uma soma, que não tem como encurtar)
+
+#define SAMPLES 32                  // Amostras de entrada que identificam um estado
+#define MAX_LEAVES 3
+#define MAX_CONSTANTS 8
+#define MAX_STEPS 16                // Instruções de um caminho (limitado pelo tamanho máximo em bytes)
+#define MAX_TARGETS 512
+#define DEFAULT_MAX_BYTES 8
+#define DEFAULT_MAX_STATES 2000000
+
+// Instrução da busca: op (Op) e o operando, índice em Search (folhas, temporária e constantes)
+typedef struct {
+    uint8_t op;
+    uint8_t operand;
+} Step;
+
+// Estado alcançado: caminho (pelo pai), tamanho em bytes e hash do AC nas amostras
+typedef struct {
+    int parent;
+    Step step;
+    uint8_t cost;
+    uint64_t ac_hash;
+} SearchNode;
+
+typedef struct {
+    char pattern[SUPEROPT_PATTERN_LEN];
+    int found;
+} Target;
+
+// Uma busca. Operandos: folhas 0..leaves-1, a temporária (índice leaves) e as constantes
+typedef struct {
+    int leaves;
+    uint8_t constants[MAX_CONSTANTS];
+    int constant_count;
+    uint8_t inputs[SAMPLES][MAX_LEAVES];
+    SearchNode *nodes;
+    int count;
+    int max_states;
+    int max_bytes;
+    uint64_t *seen;                 // Hashes dos estados já alcançados (0 = livre)
+    size_t seen_mask;
+    Target targets[MAX_TARGETS];
+    int target_count;
+} Search;
+
+// Avalia um padrão (ver SuperoptDb) com os valores das folhas em leaves
+uint8_t eval_pattern(const char **p, const uint8_t *leaves) {
+    if (**p == '(') {
+        (*p)++;
+        uint8_t l = eval_pattern(p, leaves);
+        char op = *(*p)++;
+        uint8_t r = eval_pattern(p, leaves);
+        (*p)++;     // ')'
+        return neander_fold_binary(op, l, r);
+    }
+    if (**p >= 'x' && **p <= 'z') return leaves[*(*p)++ - 'x'];
+    uint8_t value = 0;
+    while (**p >= '0' && **p <= '9') value = value * 10 + (*(*p)++ - '0');
+    return value;
+}
+
+uint8_t pattern_value(const char *pattern, const uint8_t *leaves) {
+    return eval_pattern(&pattern, leaves);
+}
+
+uint64_t hash_bytes(uint64_t h, const uint8_t *bytes, int n) {
+    for (int i = 0; i < n; i++) {
+        h ^= bytes[i];
+        h *= 0x100000001B3ull;
+    }
+    return h ? h : 1;
+}
+
+int step_size(Step step) {
+    return step.op == OP_NOT ? 1 : 2;
+}
+
+// Executa uma instrução para uma entrada (valores das folhas em leaves)
+void execute_step(const Search *s, Step step, const uint8_t *leaves, uint8_t *ac, uint8_t *t) {
+    uint8_t operand = 0;
+    if (step.operand < s->leaves) operand = leaves[step.operand];
+    else if (step.operand == s->leaves) operand = *t;
+    else operand = s->constants[step.operand - s->leaves - 1];
+
+    switch (step.op) {
+        case OP_LDA: *ac = operand; break;
+        case OP_ADD: *ac += operand; break;
+        case OP_OR: *ac |= operand; break;
+        case OP_AND: *ac &= operand; break;
+        case OP_NOT: *ac = ~*ac; break;
+        case OP_STA: *t = *ac; break;
+        default: break;
+    }
+}
+
+// Caminho da raiz até o nó index. Retorna o número de instruções
+int node_path(const Search *s, int index, Step *path) {
+    int len = 0;
+    for (int i = index; s->nodes[i].parent >= 0; i = s->nodes[i].parent) len++;
+    int k = len;
+    for (int i = index; s->nodes[i].parent >= 0; i = s->nodes[i].parent) path[--k] = s->nodes[i].step;
+    return len;
+}
+
+// Resultado do caminho para uma entrada
+uint8_t run_path(const Search *s, const Step *path, int len, const uint8_t *leaves) {
+    uint8_t ac = 0, t = 0;
+    for (int i = 0; i < len; i++) execute_step(s, path[i], leaves, &ac, &t);
+    return ac;
+}
+
+// Marca o estado como alcançado. Retorna 0 se ele já tinha sido
+int mark_seen(Search *s, uint64_t h) {
+    size_t i = h & s->seen_mask;
+    while (s->seen[i]) {
+        if (s->seen[i] == h) return 0;
+        i = (i + 1) & s->seen_mask;
+    }
+    s->seen[i] = h;
+    return 1;
+}
+
+void add_node(Search *s, int parent, Step step, int cost, uint64_t ac_hash) {
+    SearchNode *node = &s->nodes[s->count++];
+    node->parent = parent;
+    node->step = step;
+    node->cost = cost;
+    node->ac_hash = ac_hash;
+}
+
+// Gera os sucessores do nó index com instruções de size bytes
+void expand(Search *s, int index, int size) {
+    Step path[MAX_STEPS];
+    int len = node_path(s, index, path);
+    int t_written = 0;
+    uint8_t ac[SAMPLES] = {0}, t[SAMPLES] = {0};
+
+    for (int i = 0; i < len; i++) {
+        if (path[i].op == OP_STA) t_written = 1;
+    }
+    for (int k = 0; k < SAMPLES; k++) {
+        for (int i = 0; i < len; i++) execute_step(s, path[i], s->inputs[k], &ac[k], &t[k]);
+    }
+
+    static const uint8_t ops[] = {OP_LDA, OP_ADD, OP_OR, OP_AND, OP_NOT, OP_STA};
+    int operands = s->leaves + 1 + s->constant_count;
+    for (int o = 0; o < (int)sizeof(ops); o++) {
+        for (int operand = 0; operand < operands; operand++) {
+            Step step = {ops[o], operand};
+            if ((step.op == OP_NOT || step.op == OP_STA) && operand != s->leaves) continue;
+            if (step_size(step) != size) continue;
+            if (len == 0 && step.op != OP_LDA) continue;     // O AC começa sem valor
+            if (step.op != OP_STA && step.op != OP_NOT && operand == s->leaves && !t_written) continue;
+
+            uint8_t new_ac[SAMPLES], new_t[SAMPLES];
+            for (int k = 0; k < SAMPLES; k++) {
+                new_ac[k] = ac[k];
+                new_t[k] = t[k];
+                execute_step(s, step, s->inputs[k], &new_ac[k], &new_t[k]);
+            }
+            int written = t_written || step.op == OP_STA;
+            uint64_t ac_hash = hash_bytes(0xCBF29CE484222325ull, new_ac, SAMPLES);
+            uint64_t h = written ? hash_bytes(ac_hash, new_t, SAMPLES) : ac_hash;
+            if (s->count < s->max_states && mark_seen(s, h)) add_node(s, index, step, s->nodes[index].cost + size, ac_hash);
+        }
+    }
+}
+
+// Confere o caminho com todas as entradas de 8 bits
+int verify(const Search *s, const Step *path, int len, const char *pattern) {
+    uint32_t total = 1u << (8 * s->leaves);
+    for (uint32_t v = 0; v < total; v++) {
+        uint8_t leaves[MAX_LEAVES] = {v & 0xFF, v >> 8 & 0xFF, v >> 16 & 0xFF};
+        if (run_path(s, path, len, leaves) != pattern_value(pattern, leaves)) return 0;
+    }
+    return 1;
+}
+
+void write_path(const Search *s, const Step *path, int len, NeanderBuffer *out) {
+    for (int i = 0; i < len; i++) {
+        neander_buffer_printf(out, "%s%s", i ? "; " : "", neander_op_names[path[i].op]);
+        if (path[i].op == OP_NOT) continue;
+        if (path[i].operand < s->leaves) neander_buffer_printf(out, " %c", 'x' + path[i].operand);
+        else if (path[i].operand == s->leaves) neander_buffer_printf(out, " t");
+        else neander_buffer_printf(out, " #%d", s->constants[path[i].operand - s->leaves - 1]);
+    }
+}
+
+// Faz a busca e grava no banco a menor sequência de cada padrão encontrado. Retorna quantos foram encontrados
+int run_search(Search *s, NeanderBuffer *out) {
+    int found = 0;
+
+    // Amostras: valores de borda e pseudoaleatórios, fixos para a saída ser reproduzível
+    static const uint8_t edges[] = {0, 1, 2, 127, 128, 255};
+    uint32_t seed = 12345;
+    for (int k = 0; k < SAMPLES; k++) {
+        for (int l = 0; l < MAX_LEAVES; l++) {
+            seed = seed * 1103515245 + 12345;
+            s->inputs[k][l] = k < (int)sizeof(edges) ? edges[(k + l) % sizeof(edges)] : seed >> 16 & 0xFF;
+        }
+    }
+
+    s->count = 0;
+    memset(s->seen, 0, (s->seen_mask + 1) * sizeof(uint64_t));
+    add_node(s, -1, (Step){OP_NOP, 0}, 0, 0);
+
+    // Os nós saem em ordem de tamanho: do custo c, primeiro os NOT (c + 1) e depois os demais (c + 2)
+    int begin = 0;
+    for (int c = 0; c < s->max_bytes && begin < s->count; c++) {
+        int end = begin;
+        while (end < s->count && s->nodes[end].cost == c) end++;
+        for (int size = 1; size <= 2; size++) {
+            if (c + size > s->max_bytes) continue;
+            for (int i = begin; i < end; i++) expand(s, i, size);
+        }
+        begin = end;
+    }
+
+    for (int g = 0; g < s->target_count; g++) {
+        Target *target = &s->targets[g];
+        uint8_t ac[SAMPLES];
+        for (int k = 0; k < SAMPLES; k++) ac[k] = pattern_value(target->pattern, s->inputs[k]);
+        uint64_t ac_hash = hash_bytes(0xCBF29CE484222325ull, ac, SAMPLES);
+
+        for (int i = 1; i < s->count && !target->found; i++) {
+            if (s->nodes[i].ac_hash != ac_hash) continue;
+            Step path[MAX_STEPS];
+            int len = node_path(s, i, path);
+            if (!verify(s, path, len, target->pattern)) continue;
+            neander_buffer_printf(out, "%s = ", target->pattern);
+            write_path(s, path, len, out);
+            neander_buffer_printf(out, "\n");
+            target->found = 1;
+            found++;
+        }
+    }
+    return found;
+}
+
+void add_target(Search *s, const char *format, ...) {
+    va_list args;
+    Target *target = &s->targets[s->target_count++];
+
+    va_start(args, format);
+    vsnprintf(target->pattern, sizeof(target->pattern), format, args);
+    va_end(args);
+    target->found = 0;
+}
+
+// Padrões só com variáveis que têm leaves folhas distintas. As folhas são nomeadas na ordem em que
+// aparecem, como o compilador monta os padrões
+void variable_targets(Search *s, int leaves) {
+    static const char *two[] = {"xx", "xy"};
+    static const char *three[] = {"xxx", "xxy", "xyx", "xyy", "xyz"};
+    static const char ops[] = "+-*/%";
+
+    for (int n = 0; n < 2; n++) {
+        if (two[n][1] - 'x' + 1 != leaves) continue;
+        for (int o = 0; o < 5; o++) add_target(s, "(%c%c%c)", two[n][0], ops[o], two[n][1]);
+    }
+    for (int n = 0; n < 5; n++) {
+        int distinct = 0;
+        for (int i = 0; i < 3; i++) {
+            if (three[n][i] - 'x' + 1 > distinct) distinct = three[n][i] - 'x' + 1;
+        }
+        if (distinct != leaves) continue;
+        for (int o1 = 0; o1 < 2; o1++) {
+            for (int o2 = 0; o2 < 2; o2++) {
+                add_target(s, "((%c%c%c)%c%c)", three[n][0], ops[o1], three[n][1], ops[o2], three[n][2]);
+                add_target(s, "(%c%c(%c%c%c))", three[n][0], ops[o1], three[n][1], ops[o2], three[n][2]);
+            }
+        }
+    }
+}
+
+void add_constant(Search *s, uint8_t value) {
+    for (int i = 0; i < s->constant_count; i++) {
+        if (s->constants[i] == value) return;
+    }
+    s->constants[s->constant_count++] = value;
+}
+
+int main(int argc, char *argv[]) {
+    const char *filename = NULL;
+    Search s = {0};
+    s.max_bytes = DEFAULT_MAX_BYTES;
+    s.max_states = DEFAULT_MAX_STATES;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-bytes") == 0 && i + 1 < argc) {
+            s.max_bytes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-states") == 0 && i + 1 < argc) {
+            s.max_states = atoi(argv[++i]);
+        } else {
+            filename = argv[i];
+        }
+    }
+    if (!filename || s.max_bytes < 2 || s.max_bytes > MAX_STEPS || s.max_states < 1) {
+        fprintf(stderr, "Uso: %s [--max-bytes <2-%d>] [--max-states <n>] <superopt.db|->\n", argv[0], MAX_STEPS);
+        return EXIT_FAILURE;
+    }
+
+    s.nodes = malloc((size_t)s.max_states * sizeof(SearchNode));
+    size_t seen_size = 1;
+    while (seen_size < (size_t)s.max_states * 2) seen_size *= 2;
+    s.seen = malloc(seen_size * sizeof(uint64_t));
+    s.seen_mask = seen_size - 1;
+    if (!s.nodes || !s.seen) {
+        perror("Erro de memoria");
+        return EXIT_FAILURE;
+    }
+
+    NeanderBuffer out = {0};
+    int total = 0, found = 0;
+    neander_buffer_printf(&out, "# Banco do superotimizador, gerado por ./superopt --max-bytes %d\n", s.max_bytes);
+    neander_buffer_printf(&out, "# <padrao> = <instrucoes>: x, y, z sao as folhas, t uma temporaria e #v a constante v\n");
+
+    for (int leaves = 1; leaves <= MAX_LEAVES; leaves++) {
+        s.leaves = leaves;
+        s.constant_count = 0;
+        add_constant(&s, 0);
+        add_constant(&s, 1);
+        add_constant(&s, 255);
+        s.target_count = 0;
+        variable_targets(&s, leaves);
+        total += s.target_count;
+        found += run_search(&s, &out);
+    }
+
+    s.leaves = 1;
+    for (int k = 0; k < 256; k++) {
+        s.constant_count = 0;
+        add_constant(&s, 0);
+        add_constant(&s, 1);
+        add_constant(&s, 255);
+        add_constant(&s, k);
+        add_constant(&s, k - 1);
+        add_constant(&s, k + 1);
+        add_constant(&s, -k);
+        s.target_count = 0;
+        add_target(&s, "(x*%d)", k);
+        add_target(&s, "(x/%d)", k);
+        add_target(&s, "(x%%%d)", k);
+        total += s.target_count;
+        found += run_search(&s, &out);
+    }
+
+    if (out.failed) {
+        fprintf(stderr, "Erro: memoria insuficiente para o banco\n");
+        return EXIT_FAILURE;
+    }
+    int to_stdout = strcmp(filename, "-") == 0;
+    FILE *file = to_stdout ? stdout : fopen(filename, "w");
+    if (!file) {
+        perror("Erro ao criar o banco");
+        return EXIT_FAILURE;
+    }
+    fwrite(out.data, 1, out.len, file);
+    if (!to_stdout) fclose(file);
+    fprintf(stderr, "%d de %d padroes com sequencia de ate %d bytes\n", found, total, s.max_bytes);
+
+    neander_buffer_free(&out);
+    free(s.nodes);
+    free(s.seen);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+#!/bin/sh
+# Teste diferencial dos alvos nativos: cada programa é compilado para o Neander (executado pelo
+# executor) e para C e x86-64 (executados nativamente), e as variáveis finais são comparadas para
+# várias combinações de valores de entrada. Uso: ./test_native.sh [execucoes_por_programa]
+
+RUNS=${1:-40}
+CC=${CC:-cc}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+# Programas de teste: as variáveis declaradas com número são as entradas
+cat > "$DIR/soma.txt" <<'EOF'
+PROGRAMA "Soma":
+INICIO
+a = 10
+b = 20
+c = 30
+x = a + b - c
+y = (a - b) + (c - a)
+RES = a + b - c
+FIM
+EOF
+
+cat > "$DIR/mult.txt" <<'EOF'
+PROGRAMA "Mult":
+INICIO
+a = 7
+b = 9
+x = a * b
+y = (a + b) * (a - b)
+RES = x * a + b
+FIM
+EOF
+
+cat > "$DIR/div.txt" <<'EOF'
+PROGRAMA "Div":
+INICIO
+a = 200
+b = 7
+x = a / b
+RES = a % b
+FIM
+EOF
+
+cat > "$DIR/zero.txt" <<'EOF'
+PROGRAMA "Zero":
+INICIO
+b = 7
+c = 0
+RES = b / c + b % c
+FIM
+EOF
+
+cat > "$DIR/comum.txt" <<'EOF'
+PROGRAMA "Comum":
+INICIO
+a = 3
+b = 5
+c = 2
+w = y + a
+x = (a + b) * c
+y = (a + b) * c + (a + b)
+a = y - x
+RES = (a + b) / c
+FIM
+EOF
+
+cat > "$DIR/res.txt" <<'EOF'
+PROGRAMA "Res":
+INICIO
+a = 12
+b = 4
+RES = a / b + a % b
+FIM
+EOF
+
+# Variáveis do programa (sem as auxiliares), na ordem da primeira declaração, e endereço de cada
+# uma: bytes do .CODE mais a posição no .DATA (NOT, NOP e HLT ocupam 1 byte, as demais 2)
+addresses() {
+    awk '
+        /^\.DATA/ { section = "data"; next }
+        /^\.CODE/ { section = "code"; next }
+        section == "data" && NF >= 3 { name[n++] = $1 }
+        section == "code" && NF >= 1 && $1 !~ /^\./ { size += ($1 == "NOT" || $1 == "NOP" || $1 == "HLT") ? 1 : 2 }
+        END {
+            for (i = 0; i < n; i++) {
+                if (name[i] ~ /^_/ || seen[name[i]]++) continue
+                print name[i], size + i
+            }
+        }' "$1"
+}
+
+# Compara as variáveis finais do Neander (memória em $1) com as saídas dos executáveis nativos
+# (argumentos em $2; sem argumentos, uma execução com os valores iniciais)
+compare() {
+    expected=$(./executor --format binary "$1" | od -An -v -tu1 | awk -v vars="$base.vars" '
+        { for (i = 1; i <= NF; i++) byte[count++] = $i }
+        END {
+            line = ""
+            while ((getline entry < vars) > 0) {
+                split(entry, f, " ")
+                line = line (line == "" ? "" : " ") f[1] "=" byte[f[2]]
+            }
+            print line
+        }')
+    for target in c x86; do
+        if [ -n "$2" ]; then
+            # shellcheck disable=SC2086
+            got=$("$base.$target.bin" $2)
+        else
+            got=$(echo | "$base.$target.bin")
+        fi
+        total=$((total + 1))
+        if [ "$got" != "$expected" ]; then
+            failures=$((failures + 1))
+            echo "FALHA $(basename "$base").txt --target=$target:$2"
+            echo "  neander: $expected"
+            echo "  nativo:  $got"
+        fi
+    done
+}
+
+failures=0
+total=0
+seed=1
+for program in "$DIR"/*.txt; do
+    base=${program%.txt}
+    ./compilador --no-fold "$program" "$base.asm" > /dev/null || exit 1
+    ./assembler "$base.asm" "$base.mem" > /dev/null || exit 1
+    ./compilador --target=c "$program" "$base.c" > /dev/null || exit 1
+    ./compilador --target=x86 "$program" "$base.s" > /dev/null || exit 1
+    $CC -O2 -o "$base.c.bin" "$base.c" || exit 1
+    $CC -o "$base.x86.bin" "$base.s" || exit 1
+    addresses "$base.asm" > "$base.vars"
+    inputs=$(grep -E '^ *[A-Za-z][A-Za-z0-9_]* *= *[0-9]+ *$' "$program" | sed 's/ *=.*//; s/ //g' | tr 'a-z' 'A-Z' | sort -u)
+
+    compare "$base.mem" ""
+
+    # Valores aleatórios (com zeros e 255 mais frequentes), uma linha por execução
+    awk -v runs="$RUNS" -v count="$(echo $inputs | wc -w)" -v seed="$seed" 'BEGIN {
+        srand(seed)
+        for (r = 1; r < runs; r++) {
+            line = ""
+            for (i = 0; i < count; i++) {
+                x = rand()
+                line = line " " (x < 0.1 ? 0 : x < 0.2 ? 255 : int(rand() * 256))
+            }
+            print line
+        }
+    }' > "$base.values"
+    seed=$((seed + 1))
+
+    while read -r values; do
+        args=""
+        cp "$base.mem" "$base.run.mem"
+        set -- $values
+        for var in $inputs; do
+            args="$args $var=$1"
+            address=$(awk -v v="$var" '$1 == v { print $2 }' "$base.vars")
+            printf "\\$(printf %o "$1")" | dd of="$base.run.mem" bs=1 seek=$((4 + 2 * address)) conv=notrunc 2> /dev/null
+            shift
+        done
+        compare "$base.run.mem" "$args"
+    done < "$base.values"
+done
+
+echo "$total comparacoes, $failures falhas"
+[ "$failures" -eq 0 ]